@@ -0,0 +1,116 @@
+#include<cstdint>
+#include<cstdio>
+
+#include "analyzer.hpp"
+
+namespace Z80
+{
+    Analyzer::Analyzer(const uint8_t* rom, unsigned int size) : rom(rom), size(size), kinds(size, Data), labels(size, false)
+    {
+        /* Vectors of rst, taken from the opcode table, then the NMI */
+        for(unsigned int opcode = 0; opcode<256; ++opcode)
+            if(main_opcodes[opcode].flow == Flow::Restart)
+                add_entry(opcode & 0x38);
+        add_entry(0x66);
+    }
+
+    void Analyzer::add_entry(uint16_t address)
+    {
+        if(address < size)
+        {
+            labels[address] = true;
+            pending.push_back(address);
+        }
+    }
+
+    void Analyzer::analyze()
+    {
+        while(!pending.empty())
+        {
+            uint16_t address = pending.back();
+            pending.pop_back();
+            follow(address);
+        }
+    }
+
+    /* Decodes straight-line code from address, pushing the branch targets */
+    void Analyzer::follow(uint16_t address)
+    {
+        Instruction instruction;
+
+        while(kinds[address] == Data && decode(rom, size, address, instruction))
+        {
+            for(unsigned int n = 1; n<instruction.length; ++n)
+                if(kinds[address + n] != Data)
+                    return; /* Runs into known code, the bytes are ambiguous */
+
+            kinds[address] = Code;
+            for(unsigned int n = 1; n<instruction.length; ++n)
+                kinds[address + n] = Operand;
+            instructions[address] = instruction;
+
+            switch(instruction.flow)
+            {
+                case Flow::Jump:
+                    add_entry(instruction.target);
+                    return;
+                case Flow::Branch:
+                case Flow::Call:
+                case Flow::CondCall:
+                case Flow::Restart:
+                    add_entry(instruction.target);
+                    break;
+                case Flow::Return:
+                case Flow::Indirect:
+                    return;
+                case Flow::Next:
+                case Flow::CondReturn:
+                case Flow::Halt:
+                    break;
+            }
+
+            if(address + instruction.length >= size)
+                return;
+            address += instruction.length;
+        }
+    }
+
+    const Instruction* Analyzer::get_instruction(uint16_t address) const
+    {
+        auto it = instructions.find(address);
+        return it == instructions.end() ? nullptr : &it->second;
+    }
+
+    void Analyzer::print(FILE* out, const Symbols* symbols) const
+    {
+        unsigned int address = 0;
+        uint16_t offset;
+
+        while(address < size)
+        {
+            const char* name = symbols ? symbols->find(address, &offset) : nullptr;
+            if(name && !offset)
+                fprintf(out, "%s:\n", name);
+            else if(labels[address])
+                fprintf(out, "L%04X:\n", address);
+
+            if(kinds[address] == Code)
+            {
+                const Instruction& instruction = instructions.at(address);
+                fprintf(out, "    %-24s ; %04X\n", instruction.text, address);
+                address += instruction.length;
+                continue;
+            }
+
+            /* Data up to 8 bytes per line, or to the next label or instruction */
+            unsigned int start = address;
+            fprintf(out, "    db ");
+            do
+            {
+                fprintf(out, rom[address] >= 0xA0 ? "%s0%02xh" : "%s%02xh", address == start ? "" : ", ", rom[address]);
+                address++;
+            } while(address < size && address - start < 8 && kinds[address] != Code && !labels[address]);
+            fprintf(out, "\n");
+        }
+    }
+}
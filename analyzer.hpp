@@ -0,0 +1,52 @@
+#ifndef Z80_ANALYZER_H
+#define Z80_ANALYZER_H
+
+#include<cstdint>
+#include<cstdio>
+#include<vector>
+#include<map>
+
+#include "opcodes.hpp"
+#include "symbols.hpp"
+
+namespace Z80
+{
+    /* Code and data map of a ROM, found by following the control flow from
+     * the reset, restart and NMI vectors and the entries added by the host.
+     * Jumps through registers are not followed, their targets have to be
+     * added as entries. */
+    class Analyzer
+    {
+        public:
+            enum Kind : uint8_t
+            {
+                Data,     /* Never reached, or not yet analyzed */
+                Code,     /* First byte of an instruction */
+                Operand   /* Other bytes of an instruction */
+            };
+
+            Analyzer(const uint8_t* rom, unsigned int size);
+
+            void add_entry(uint16_t address);
+            void analyze();
+
+            Kind get_kind(uint16_t address) const { return address < size ? static_cast<Kind>(kinds[address]) : Data; }
+            const Instruction* get_instruction(uint16_t address) const;
+            bool is_label(uint16_t address) const { return address < size && labels[address]; }
+
+            void print(FILE* out, const Symbols* symbols = nullptr) const; /* Listing with the data left as db lines */
+
+        private:
+            const uint8_t* rom;
+            unsigned int size;
+
+            std::vector<uint8_t> kinds;
+            std::vector<bool> labels;
+            std::map<uint16_t, Instruction> instructions;
+            std::vector<uint16_t> pending;
+
+            void follow(uint16_t address);
+    };
+}
+
+#endif
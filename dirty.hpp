@@ -0,0 +1,61 @@
+#ifndef Z80_DIRTY_H
+#define Z80_DIRTY_H
+
+#include<cstdint>
+
+namespace Z80
+{
+    /* Addresses first to last of consecutive written pages */
+    struct MemoryRange
+    {
+        uint16_t first;
+        uint16_t last;
+    };
+
+    /* Copy of a bitmap of 256 written pages, iterated as ranges of pages:
+     * for(MemoryRange range : cpu.dirty_ranges()) ... */
+    class DirtyRanges
+    {
+        public:
+            class Iterator
+            {
+                public:
+                    Iterator(const uint64_t* bits, unsigned int page) : bits(bits), page(page), after(page) { next(); }
+                    MemoryRange operator*() const { return {uint16_t(page << 8), uint16_t((after << 8) - 1)}; }
+                    Iterator& operator++() { page = after; next(); return *this; }
+                    bool operator!=(const Iterator& other) const { return page != other.page; }
+
+                private:
+                    const uint64_t* bits;
+                    unsigned int page;  /* First page of the range */
+                    unsigned int after; /* Page following it */
+
+                    /* First page from page on whose bit is set, or 256 */
+                    unsigned int find(unsigned int from, bool set) const
+                    {
+                        while(from < 256)
+                        {
+                            uint64_t word = (set ? bits[from >> 6] : ~bits[from >> 6]) >> (from & 63);
+                            if(word)
+                                return from + __builtin_ctzll(word);
+                            from = (from | 63) + 1;
+                        }
+                        return 256;
+                    }
+                    void next()
+                    {
+                        page = find(after, true);
+                        after = find(page, false);
+                    }
+            };
+
+            DirtyRanges(const uint64_t* pages) : bits{pages[0], pages[1], pages[2], pages[3]} {}
+            Iterator begin() const { return Iterator(bits, 0); }
+            Iterator end() const { return Iterator(bits, 256); }
+
+        private:
+            uint64_t bits[4];
+    };
+}
+
+#endif
@@ -0,0 +1,38 @@
+#include<cstdint>
+#include<cstring>
+
+#include "frame.hpp"
+
+namespace Z80
+{
+    FrameExport::FrameExport(std::initializer_list<MemoryRange> ranges) : ranges(ranges)
+    {
+        unsigned int size = 0;
+
+        for(const MemoryRange& range : ranges)
+        {
+            offsets.push_back(size);
+            size += range.last - range.first + 1;
+        }
+        stride = (size + 63) & ~63u; /* Buffers do not share cache lines */
+        storage.resize(3 * stride);
+    }
+
+    void FrameExport::publish(const uint8_t* memory)
+    {
+        uint8_t* data = buffer(back);
+
+        for(unsigned int n = 0; n<ranges.size(); ++n)
+            memcpy(data + offsets[n], memory + ranges[n].first, ranges[n].last - ranges[n].first + 1);
+        numbers[back] = ++published;
+        back = middle.exchange(back | FRESH, std::memory_order_acq_rel) & 3;
+    }
+
+    bool FrameExport::update()
+    {
+        if(!(middle.load(std::memory_order_relaxed) & FRESH))
+            return false;
+        front = middle.exchange(front, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef Z80_FRAME_H
+#define Z80_FRAME_H
+
+#include<cstdint>
+#include<atomic>
+#include<vector>
+#include<initializer_list>
+
+#include "dirty.hpp"
+
+namespace Z80
+{
+    /* Memory ranges handed from the CPU thread to a reader, such as a
+     * renderer, at each frame boundary. There are three buffers: the CPU
+     * fills one, the reader holds one and the last one is the latest
+     * complete frame. Both sides swap theirs with it by one atomic exchange,
+     * so neither ever waits and the reader never sees a frame half written. */
+    class FrameExport
+    {
+        public:
+            FrameExport(std::initializer_list<MemoryRange> ranges);
+
+            /* CPU side, called by the core at the end of each frame */
+            void publish(const uint8_t* memory);
+
+            /* Reader side */
+            bool update(); /* Takes the latest frame, false if none is newer than the one held */
+            uint64_t frame() const { return numbers[front]; } /* 1 for the first frame, 0 before it */
+            const uint8_t* view(unsigned int range) const { return buffer(front) + offsets[range]; }
+
+        private:
+            static constexpr unsigned int FRESH = 4; /* In middle, set until the reader takes the frame */
+
+            std::vector<MemoryRange> ranges;
+            std::vector<unsigned int> offsets; /* Of each range in a buffer */
+            unsigned int stride;               /* Bytes per buffer, whole cache lines */
+            std::vector<uint8_t> storage;
+
+            uint64_t numbers[3] = {0};
+            uint64_t published = 0;
+            unsigned int back = 0;                /* Written by the CPU */
+            alignas(64) std::atomic<unsigned int> middle{1};
+            alignas(64) unsigned int front = 2;   /* Read by the reader */
+
+            uint8_t* buffer(unsigned int n) { return storage.data() + n * stride; }
+            const uint8_t* buffer(unsigned int n) const { return storage.data() + n * stride; }
+    };
+}
+
+#endif
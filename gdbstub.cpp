@@ -0,0 +1,431 @@
+#include<cstdint>
+#include<cstring>
+#include<cstdio>
+#include<string>
+
+#include<unistd.h>
+#include<poll.h>
+#include<sys/socket.h>
+#include<sys/un.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+
+#include "gdbstub.hpp"
+
+namespace Z80
+{
+    static const char hex_digits[] = "0123456789abcdef";
+
+    static std::string to_hex(uint8_t byte)
+    {
+        std::string s;
+        s += hex_digits[byte >> 4];
+        s += hex_digits[byte & 0xF];
+        return s;
+    }
+
+    static int from_hex(char c)
+    {
+        if(c >= '0' && c <= '9') return c - '0';
+        if(c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if(c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static unsigned int parse_hex(const std::string& s, size_t& pos)
+    {
+        unsigned int value = 0;
+        while(pos < s.size() && from_hex(s[pos]) >= 0)
+            value = value << 4 | from_hex(s[pos++]);
+        return value;
+    }
+
+    GDBStub::GDBStub(Z80& cpu) : cpu(cpu)
+    {
+    }
+
+    GDBStub::~GDBStub()
+    {
+        close_client();
+        if(server_fd >= 0)
+            close(server_fd);
+    }
+
+    bool GDBStub::listen(uint16_t port)
+    {
+        sockaddr_in addr;
+        int one = 1;
+
+        server_fd = socket(AF_INET, SOCK_STREAM, 0);
+        if(server_fd < 0)
+            return false;
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if(bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(server_fd, 1) < 0)
+        {
+            printf("Cannot listen on port %u\n", port);
+            close(server_fd);
+            server_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    bool GDBStub::listen(const char* path)
+    {
+        sockaddr_un addr;
+
+        if(strlen(path) >= sizeof(addr.sun_path))
+            return false;
+
+        server_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(server_fd < 0)
+            return false;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+        unlink(path);
+
+        if(bind(server_fd, (sockaddr*)&addr, sizeof(addr)) < 0 || ::listen(server_fd, 1) < 0)
+        {
+            printf("Cannot listen on %s\n", path);
+            close(server_fd);
+            server_fd = -1;
+            return false;
+        }
+        return true;
+    }
+
+    void GDBStub::serve()
+    {
+        if(accept_client(true))
+            session();
+    }
+
+    void GDBStub::poll()
+    {
+        if(client_fd < 0)
+        {
+            if(accept_client(false))
+                session();
+            return;
+        }
+
+        /* Continued, the host ran a frame since the last call */
+        Status status = cpu.get_status();
+        if(status == Status::Breakpoint || status == Status::Unimplemented || interrupt_pending())
+            stop(status);
+    }
+
+    bool GDBStub::accept_client(bool blocking)
+    {
+        if(server_fd < 0)
+            return false;
+
+        if(!blocking)
+        {
+            pollfd pfd = {server_fd, POLLIN, 0};
+            if(::poll(&pfd, 1, 0) <= 0)
+                return false;
+        }
+
+        client_fd = accept(server_fd, nullptr, nullptr);
+        if(client_fd < 0)
+            return false;
+
+        int one = 1;
+        setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)); /* Fails harmlessly on Unix sockets */
+        return true;
+    }
+
+    void GDBStub::close_client()
+    {
+        if(client_fd >= 0)
+            close(client_fd);
+        client_fd = -1;
+        running = false;
+    }
+
+    void GDBStub::session()
+    {
+        std::string packet;
+
+        /* The CPU is stopped as soon as a debugger attaches, and until it continues */
+        while(client_fd >= 0 && !running)
+        {
+            if(!read_packet(packet) || !handle_packet(packet))
+                close_client();
+        }
+        if(client_fd < 0)
+            cpu.clear_breakpoints();
+    }
+
+    bool GDBStub::read_packet(std::string& packet)
+    {
+        char c;
+        packet.clear();
+
+        /* Skip acks and anything before the start of a packet */
+        do
+        {
+            if(read(client_fd, &c, 1) != 1)
+                return false;
+        } while(c != '$');
+
+        while(true)
+        {
+            if(read(client_fd, &c, 1) != 1)
+                return false;
+            if(c == '#')
+                break;
+            packet += c;
+        }
+
+        char checksum[2];
+        if(read(client_fd, checksum, 2) != 2)
+            return false;
+
+        uint8_t sum = 0;
+        for(char p : packet)
+            sum += p;
+
+        if((from_hex(checksum[0]) << 4 | from_hex(checksum[1])) != sum)
+        {
+            write(client_fd, "-", 1);
+            return read_packet(packet);
+        }
+        write(client_fd, "+", 1);
+        return true;
+    }
+
+    void GDBStub::send_packet(const std::string& data)
+    {
+        uint8_t sum = 0;
+        for(char c : data)
+            sum += c;
+
+        std::string out = "$" + data + "#" + to_hex(sum);
+        write(client_fd, out.data(), out.size());
+    }
+
+    bool GDBStub::interrupt_pending()
+    {
+        pollfd pfd = {client_fd, POLLIN, 0};
+        if(::poll(&pfd, 1, 0) <= 0)
+            return false;
+
+        char c;
+        if(read(client_fd, &c, 1) != 1)
+        {
+            close_client();
+            return true;
+        }
+        return c == 0x03; /* Ctrl-C from the debugger */
+    }
+
+    bool GDBStub::handle_packet(const std::string& packet)
+    {
+        size_t pos = 1;
+        std::string reply;
+
+        if(packet.empty())
+        {
+            send_packet("");
+            return true;
+        }
+
+        switch(packet[0])
+        {
+            case '?':
+                reply = "S05"; break;
+            case 'g':
+                reply = read_registers(); break;
+            case 'G':
+                write_registers(packet.substr(1));
+                reply = "OK"; break;
+            case 'p':
+                {
+                    uint16_t value = read_register(parse_hex(packet, pos));
+                    reply = to_hex(value & 0xFF) + to_hex(value >> 8);
+                }
+                break;
+            case 'P':
+                {
+                    unsigned int n = parse_hex(packet, pos);
+                    pos++; /* '=' */
+                    unsigned int value = parse_hex(packet, pos);
+                    write_register(n, (value & 0xFF) << 8 | (value >> 8 & 0xFF)); /* Sent in target byte order */
+                    reply = "OK";
+                }
+                break;
+            case 'm':
+                {
+                    uint16_t address = parse_hex(packet, pos);
+                    pos++; /* ',' */
+                    unsigned int length = parse_hex(packet, pos);
+                    for(unsigned int n = 0; n<length; ++n)
+                        reply += to_hex(peek(address + n));
+                }
+                break;
+            case 'M':
+                {
+                    uint16_t address = parse_hex(packet, pos);
+                    pos++; /* ',' */
+                    unsigned int length = parse_hex(packet, pos);
+                    pos++; /* ':' */
+                    reply = "OK";
+                    for(unsigned int n = 0; n<length && pos+1 < packet.size(); ++n, pos += 2)
+                        if(!poke(address + n, from_hex(packet[pos]) << 4 | from_hex(packet[pos+1])))
+                        {
+                            reply = "E0e"; /* EFAULT */
+                            break;
+                        }
+                }
+                break;
+            case 'c':
+                if(pos < packet.size())
+                    cpu.pc = parse_hex(packet, pos);
+                running = true;
+                return true; /* Reply is sent by stop() */
+            case 's':
+                if(pos < packet.size())
+                    cpu.pc = parse_hex(packet, pos);
+                single_step();
+                reply = "S05"; break;
+            case 'Z':
+            case 'z':
+                if(packet[1] == '0' || packet[1] == '1') /* Software and hardware breakpoints are the same thing here */
+                {
+                    pos = 3;
+                    cpu.set_breakpoint(parse_hex(packet, pos) & 0xFFFF, packet[0] == 'Z');
+                    reply = "OK";
+                }
+                break;
+            case 'q':
+                if(packet.compare(0, 10, "qSupported") == 0)
+                    reply = "PacketSize=1000";
+                else if(packet == "qAttached")
+                    reply = "1";
+                else if(packet == "qC")
+                    reply = "QC1";
+                break;
+            case 'H':
+                reply = "OK"; break;
+            case 'D':
+                send_packet("OK");
+                return false;
+            case 'k':
+                return false;
+        }
+
+        send_packet(reply);
+        return true;
+    }
+
+    void GDBStub::stop(Status status)
+    {
+        running = false;
+        if(client_fd >= 0)
+            send_packet(status == Status::Unimplemented ? "S04" : "S05"); /* SIGILL or SIGTRAP */
+        session();
+    }
+
+    void GDBStub::single_step()
+    {
+        cpu.status = Status::Ok; /* Left over from the last stop otherwise */
+        cpu.execute(cpu.fetch(0));
+    }
+
+    /* Register numbering follows GDB's z80 target description */
+    uint16_t GDBStub::read_register(unsigned int n)
+    {
+        switch(n)
+        {
+            case 0: return cpu.AF.p;
+            case 1: return cpu.BC.p;
+            case 2: return cpu.DE.p;
+            case 3: return cpu.HL.p;
+            case 4: return cpu.sp;
+            case 5: return cpu.pc;
+            case 6: return cpu.IX.p;
+            case 7: return cpu.IY.p;
+            case 8: return cpu.AF_.p;
+            case 9: return cpu.BC_.p;
+            case 10: return cpu.DE_.p;
+            case 11: return cpu.HL_.p;
+            case 12: return cpu.i << 8 | cpu.refresh();
+        }
+        return 0;
+    }
+
+    void GDBStub::write_register(unsigned int n, uint16_t value)
+    {
+        switch(n)
+        {
+            case 0: cpu.AF.p = value; break;
+            case 1: cpu.BC.p = value; break;
+            case 2: cpu.DE.p = value; break;
+            case 3: cpu.HL.p = value; break;
+            case 4: cpu.sp = value; break;
+            case 5: cpu.pc = value; break;
+            case 6: cpu.IX.p = value; break;
+            case 7: cpu.IY.p = value; break;
+            case 8: cpu.AF_.p = value; break;
+            case 9: cpu.BC_.p = value; break;
+            case 10: cpu.DE_.p = value; break;
+            case 11: cpu.HL_.p = value; break;
+            case 12: cpu.i = value >> 8; cpu.set_refresh(value & 0xFF); break;
+        }
+    }
+
+    std::string GDBStub::read_registers()
+    {
+        std::string data;
+        for(unsigned int n = 0; n<13; ++n)
+        {
+            uint16_t value = read_register(n);
+            data += to_hex(value & 0xFF) + to_hex(value >> 8);
+        }
+        return data;
+    }
+
+    void GDBStub::write_registers(const std::string& data)
+    {
+        for(unsigned int n = 0; n<13 && n*4+3 < data.size(); ++n)
+        {
+            const char* d = data.c_str() + n*4;
+            write_register(n, (from_hex(d[2]) << 12) | (from_hex(d[3]) << 8) | (from_hex(d[0]) << 4) | from_hex(d[1]));
+        }
+    }
+
+    /* Instructions are fetched from the ROM, data lives in memory */
+    uint8_t GDBStub::peek(uint16_t address)
+    {
+        if(uint8_t* code = cpu.rom_location(address))
+            return *code;
+        return cpu.memory[address];
+    }
+
+    bool GDBStub::poke(uint16_t address, uint8_t value)
+    {
+        if(cpu.rom_location(address))
+        {
+            if(!cpu.own_rom()) /* The pages of a shared ROM are read-only */
+                return false;
+            *cpu.rom_location(address) = value;
+        }
+        else
+        {
+            cpu.memory[address] = value;
+            cpu.mark_dirty(address);
+        }
+        return true;
+    }
+}
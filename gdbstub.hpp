@@ -0,0 +1,59 @@
+#ifndef Z80_GDBSTUB_H
+#define Z80_GDBSTUB_H
+
+#include<cstdint>
+#include<string>
+
+#include "z80.hpp"
+
+namespace Z80
+{
+    /* GDB remote serial protocol server, run between frames by the host.
+     * While the debugger has the CPU stopped, the stub serves its packets.
+     * Once it continues, the host's loop runs frames as usual, interrupts
+     * and pacing included, and each poll() looks for Ctrl-C or a stop of the
+     * last frame on a breakpoint. The interpreter has no hook to test while
+     * nobody is debugging. */
+    class GDBStub
+    {
+        public:
+            GDBStub(Z80& cpu);
+            ~GDBStub();
+
+            bool listen(uint16_t port);       /* TCP on 127.0.0.1 */
+            bool listen(const char* path);    /* Unix domain socket */
+
+            void serve(); /* Blocks until a debugger attaches and continues or detaches */
+            void poll();  /* To be called between frames, blocks only while the debugger has the CPU stopped */
+            bool attached() const { return client_fd >= 0; }
+
+        private:
+            Z80& cpu;
+
+            int server_fd = -1;
+            int client_fd = -1;
+
+            bool running = false; /* Debugger sent c, the host runs frames until a stop */
+
+            bool accept_client(bool blocking);
+            void session();
+            void close_client();
+
+            bool handle_packet(const std::string& packet);
+            bool read_packet(std::string& packet);
+            void send_packet(const std::string& data);
+            bool interrupt_pending();
+
+            void stop(Status status); /* Reports the stop of a continued CPU and serves packets again */
+            void single_step();
+
+            std::string read_registers();
+            void write_registers(const std::string& data);
+            uint16_t read_register(unsigned int n);
+            void write_register(unsigned int n, uint16_t value);
+            uint8_t peek(uint16_t address);
+            bool poke(uint16_t address, uint8_t value); /* False if the byte cannot be written */
+    };
+}
+
+#endif
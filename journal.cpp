@@ -0,0 +1,181 @@
+#include<cstdint>
+#include<cstring>
+#include<cstdio>
+#include<fstream>
+
+#include "journal.hpp"
+
+namespace Z80
+{
+    struct JournalHeader
+    {
+        char magic[4];  /* "Z80J" */
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t size;  /* Bytes of events following the header */
+    };
+
+    const uint16_t JOURNAL_VERSION = 1;
+
+    void Journal::put(uint8_t tag, uint64_t time)
+    {
+        uint64_t delta = time - last_time;
+
+        last_time = time;
+        stream.push_back(tag);
+        do
+        {
+            stream.push_back((delta & 0x7F) | (delta > 0x7F ? 0x80 : 0));
+            delta >>= 7;
+        } while(delta);
+    }
+
+    void Journal::record_port(uint64_t time, uint8_t port, uint8_t value)
+    {
+        put(PORT, time);
+        stream.push_back(port);
+        stream.push_back(value);
+    }
+
+    void Journal::record_interrupt(uint64_t time)
+    {
+        put(INTERRUPT, time);
+    }
+
+    uint8_t Journal::decode(size_t& at, uint64_t& time) const
+    {
+        uint64_t delta = 0;
+        unsigned int shift = 0;
+
+        if(at >= stream.size())
+            return END;
+
+        uint8_t tag = stream[at++];
+        while(at < stream.size())
+        {
+            uint8_t byte = stream[at++];
+            delta |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            shift += 7;
+            if(!(byte & 0x80))
+            {
+                time += delta;
+                return tag;
+            }
+        }
+        return END;
+    }
+
+    void Journal::advance()
+    {
+        next_time = last_time;
+        next_tag = decode(position, next_time);
+    }
+
+    bool Journal::replay_port(uint64_t time, uint8_t port, uint8_t& value)
+    {
+        if(next_tag != PORT || position + 2 > stream.size())
+        {
+            desync = true;
+            return false;
+        }
+
+        if(stream[position] != port || next_time != time)
+            desync = true;
+        value = stream[position+1];
+        position += 2;
+        last_time = next_time;
+        advance();
+        return true;
+    }
+
+    bool Journal::interrupt_due(uint64_t time)
+    {
+        if(next_tag != INTERRUPT || next_time > time)
+            return false;
+
+        if(next_time != time)
+            desync = true; /* Only happens when the run already went astray */
+        last_time = next_time;
+        advance();
+        upcoming_known = false;
+        return true;
+    }
+
+    uint64_t Journal::next_interrupt()
+    {
+        if(!upcoming_known)
+        {
+            uint8_t tag = next_tag;
+            uint64_t time = next_time;
+            size_t at = position;
+
+            while(tag == PORT)
+            {
+                at += 2; /* Port and value */
+                tag = decode(at, time);
+            }
+            upcoming_interrupt = tag == INTERRUPT ? time : UINT64_MAX;
+            upcoming_known = true;
+        }
+        return upcoming_interrupt;
+    }
+
+    void Journal::rewind()
+    {
+        mode = Mode::Replay;
+        desync = false;
+        position = 0;
+        last_time = 0;
+        upcoming_known = false;
+        advance();
+    }
+
+    bool Journal::save(const char* filename) const
+    {
+        JournalHeader header = {{'Z', '8', '0', 'J'}, JOURNAL_VERSION, 0, static_cast<uint32_t>(stream.size())};
+
+        std::ofstream file(filename, std::ios::binary|std::ios::trunc);
+        if(!file.is_open())
+        {
+            printf("Cannot write to: %s\n", filename);
+            return false;
+        }
+        file.write(reinterpret_cast<char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(stream.data()), stream.size());
+        return file.good();
+    }
+
+    bool Journal::load(const char* filename)
+    {
+        JournalHeader header;
+
+        std::ifstream file(filename, std::ios::binary);
+        if(!file.is_open())
+        {
+            printf("No such file: %s\n", filename);
+            return false;
+        }
+        if(!file.read(reinterpret_cast<char*>(&header), sizeof(header))
+           || memcmp(header.magic, "Z80J", 4) != 0
+           || header.version != JOURNAL_VERSION)
+            return false;
+
+        /* The header is not trusted with the allocation, the file has to hold that much */
+        std::streamoff start = file.tellg();
+        file.seekg(0, std::ios::end);
+        std::streamoff available = file.tellg() - start;
+        file.seekg(start);
+        if(available < 0 || header.size > static_cast<uint64_t>(available))
+        {
+            printf("Truncated journal: %s\n", filename);
+            return false;
+        }
+
+        stream.resize(header.size);
+        if(!file.read(reinterpret_cast<char*>(stream.data()), header.size))
+            return false;
+
+        rewind();
+        return true;
+    }
+}
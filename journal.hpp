@@ -0,0 +1,59 @@
+#ifndef Z80_JOURNAL_H
+#define Z80_JOURNAL_H
+
+#include<cstdint>
+#include<cstddef>
+#include<vector>
+
+namespace Z80
+{
+    /* Inputs a run depends on: the values read from ports and the times
+     * interrupts arrived at. Each event is a tag byte, the T-states elapsed
+     * since the previous event as a LEB128 number, and for port reads the
+     * port and the value. Replaying a journal gives the same run again. */
+    class Journal
+    {
+        public:
+            enum class Mode { Record, Replay };
+
+            Journal(Mode mode = Mode::Record) : mode(mode) {}
+
+            bool save(const char* filename) const;
+            bool load(const char* filename); /* Replays from the first event */
+            void rewind();
+
+            Mode get_mode() const { return mode; }
+            bool desynced() const { return desync; } /* The run asked for something else than what was recorded */
+            size_t size() const { return stream.size(); }
+
+            /* Called by the core */
+            void record_port(uint64_t time, uint8_t port, uint8_t value);
+            void record_interrupt(uint64_t time);
+            bool replay_port(uint64_t time, uint8_t port, uint8_t& value);
+            bool interrupt_due(uint64_t time); /* Consumes the interrupt when it is */
+            uint64_t next_interrupt(); /* Time of the next interrupt of a replay, UINT64_MAX after the last */
+
+        private:
+            enum Tag : uint8_t { PORT = 0, INTERRUPT = 1, END = 0xFF };
+
+            Mode mode;
+            bool desync = false;
+            std::vector<uint8_t> stream;
+            size_t position = 0;
+            uint64_t last_time = 0;
+
+            /* Next event of a replay, decoded ahead */
+            uint8_t next_tag = END;
+            uint64_t next_time = 0;
+
+            /* Time of the next interrupt, looked up past the port reads before it */
+            uint64_t upcoming_interrupt = 0;
+            bool upcoming_known = false;
+
+            void put(uint8_t tag, uint64_t time);
+            uint8_t decode(size_t& at, uint64_t& time) const; /* Event at at, time is that of the previous one */
+            void advance();
+    };
+}
+
+#endif
@@ -0,0 +1,70 @@
+#include<cstdint>
+#include<cstdio>
+#include<string>
+
+#include "metrics.hpp"
+
+namespace Z80
+{
+    struct MetricInfo
+    {
+        const char* name;
+        const char* type;
+        const char* help;
+        Counter Metrics::*counter;
+    };
+
+    static const MetricInfo metric_infos[] =
+    {
+        {"z80_instructions_total", "counter", "Instructions retired", &Metrics::instructions},
+        {"z80_t_states_total", "counter", "T-states emulated", &Metrics::t_states},
+        {"z80_halt_t_states_total", "counter", "T-states spent halted", &Metrics::halt_t_states},
+        {"z80_interrupts_total", "counter", "Interrupts accepted", &Metrics::interrupts},
+        {"z80_block_bytes_total", "counter", "Bytes moved by block instructions", &Metrics::block_bytes},
+        {"z80_port_reads_total", "counter", "Port reads", &Metrics::port_reads},
+        {"z80_port_writes_total", "counter", "Port writes", &Metrics::port_writes},
+        {"z80_frames_total", "counter", "Frames run", &Metrics::frames},
+        {"z80_frame_nanoseconds", "gauge", "Host time of the last frame", &Metrics::frame_ns},
+        {"z80_host_nanoseconds_total", "counter", "Host time of all frames", &Metrics::host_ns},
+    };
+
+    /* Label values escape backslashes, quotes and line feeds */
+    static std::string escape(const char* s)
+    {
+        std::string escaped;
+        for(; *s; ++s)
+        {
+            if(*s == '\\' || *s == '"')
+                escaped += '\\';
+            if(*s == '\n')
+                escaped += "\\n";
+            else
+                escaped += *s;
+        }
+        return escaped;
+    }
+
+    bool write_prometheus(const char* filename, const MetricsSource* sources, unsigned int count)
+    {
+        std::string temporary = std::string(filename) + ".tmp";
+        FILE* out = fopen(temporary.c_str(), "w");
+        if(!out)
+            return false;
+
+        for(const MetricInfo& info : metric_infos)
+        {
+            fprintf(out, "# HELP %s %s\n# TYPE %s %s\n", info.name, info.help, info.name, info.type);
+            for(unsigned int n = 0; n<count; ++n)
+                fprintf(out, "%s{instance=\"%s\"} %llu\n", info.name, escape(sources[n].instance).c_str(),
+                        (unsigned long long)(sources[n].metrics->*info.counter).get());
+        }
+
+        bool ok = fclose(out) == 0;
+        if(!ok || rename(temporary.c_str(), filename) != 0)
+        {
+            remove(temporary.c_str());
+            return false;
+        }
+        return true;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef Z80_METRICS_H
+#define Z80_METRICS_H
+
+#include<cstdint>
+#include<atomic>
+
+namespace Z80
+{
+    /* Counter written by one thread and read by any. The writer adds with a
+     * relaxed load and store instead of a locked read-modify-write, so
+     * counting costs about as much as with a plain integer. */
+    class Counter
+    {
+        public:
+            void add(uint64_t n) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+            void sub(uint64_t n) { value.store(value.load(std::memory_order_relaxed) - n, std::memory_order_relaxed); }
+            void set(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+            uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+        private:
+            std::atomic<uint64_t> value{0};
+    };
+
+    /* Counters of one CPU, see Z80Core::get_metrics() */
+    struct Metrics
+    {
+        Counter instructions;  /* Retired, with variant::metrics only */
+        Counter t_states;      /* Run, added at the end of each run() and for halted frames */
+        Counter halt_t_states; /* Spent halted by step() */
+        Counter interrupts;    /* Accepted */
+        Counter block_bytes;   /* Moved by ldi, ldd, ini, ind, outi, outd and their repeats */
+        Counter port_reads;
+        Counter port_writes;
+        Counter frames;        /* Run by step() */
+        Counter frame_ns;      /* Host time of the last frame, without the wait for its end */
+        Counter host_ns;       /* Host time of all frames */
+    };
+
+    struct MetricsSource
+    {
+        const char* instance; /* Label of the CPU */
+        const Metrics* metrics;
+    };
+
+    /* Writes the metrics of all the CPUs in the Prometheus text format. The
+     * file is replaced at once, so a scraper never reads it half written */
+    bool write_prometheus(const char* filename, const MetricsSource* sources, unsigned int count);
+}
+
+#endif
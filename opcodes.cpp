@@ -0,0 +1,689 @@
+#include<cstdint>
+#include<cstdio>
+#include<cctype>
+#include<string>
+
+#include "opcodes.hpp"
+
+namespace Z80
+{
+    /* Unprefixed instructions */
+    const OpcodeInfo main_opcodes[256] =
+    {
+        {"nop", 1, Flow::Next, Operand::None}, /* 00 */
+        {"ld bc, **", 3, Flow::Next, Operand::Word}, /* 01 */
+        {"ld (bc), a", 1, Flow::Next, Operand::None}, /* 02 */
+        {"inc bc", 1, Flow::Next, Operand::None}, /* 03 */
+        {"inc b", 1, Flow::Next, Operand::None}, /* 04 */
+        {"dec b", 1, Flow::Next, Operand::None}, /* 05 */
+        {"ld b, *", 2, Flow::Next, Operand::Byte}, /* 06 */
+        {"rlca", 1, Flow::Next, Operand::None}, /* 07 */
+        {"ex af, af'", 1, Flow::Next, Operand::None}, /* 08 */
+        {"add hl, bc", 1, Flow::Next, Operand::None}, /* 09 */
+        {"ld a, (bc)", 1, Flow::Next, Operand::None}, /* 0A */
+        {"dec bc", 1, Flow::Next, Operand::None}, /* 0B */
+        {"inc c", 1, Flow::Next, Operand::None}, /* 0C */
+        {"dec c", 1, Flow::Next, Operand::None}, /* 0D */
+        {"ld c, *", 2, Flow::Next, Operand::Byte}, /* 0E */
+        {"rrca", 1, Flow::Next, Operand::None}, /* 0F */
+        {"djnz *", 2, Flow::Branch, Operand::Relative}, /* 10 */
+        {"ld de, **", 3, Flow::Next, Operand::Word}, /* 11 */
+        {"ld (de), a", 1, Flow::Next, Operand::None}, /* 12 */
+        {"inc de", 1, Flow::Next, Operand::None}, /* 13 */
+        {"inc d", 1, Flow::Next, Operand::None}, /* 14 */
+        {"dec d", 1, Flow::Next, Operand::None}, /* 15 */
+        {"ld d, *", 2, Flow::Next, Operand::Byte}, /* 16 */
+        {"rla", 1, Flow::Next, Operand::None}, /* 17 */
+        {"jr *", 2, Flow::Jump, Operand::Relative}, /* 18 */
+        {"add hl, de", 1, Flow::Next, Operand::None}, /* 19 */
+        {"ld a, (de)", 1, Flow::Next, Operand::None}, /* 1A */
+        {"dec de", 1, Flow::Next, Operand::None}, /* 1B */
+        {"inc e", 1, Flow::Next, Operand::None}, /* 1C */
+        {"dec e", 1, Flow::Next, Operand::None}, /* 1D */
+        {"ld e, *", 2, Flow::Next, Operand::Byte}, /* 1E */
+        {"rra", 1, Flow::Next, Operand::None}, /* 1F */
+        {"jr nz, *", 2, Flow::Branch, Operand::Relative}, /* 20 */
+        {"ld hl, **", 3, Flow::Next, Operand::Word}, /* 21 */
+        {"ld (**), hl", 3, Flow::Next, Operand::Word}, /* 22 */
+        {"inc hl", 1, Flow::Next, Operand::None}, /* 23 */
+        {"inc h", 1, Flow::Next, Operand::None}, /* 24 */
+        {"dec h", 1, Flow::Next, Operand::None}, /* 25 */
+        {"ld h, *", 2, Flow::Next, Operand::Byte}, /* 26 */
+        {"daa", 1, Flow::Next, Operand::None}, /* 27 */
+        {"jr z, *", 2, Flow::Branch, Operand::Relative}, /* 28 */
+        {"add hl, hl", 1, Flow::Next, Operand::None}, /* 29 */
+        {"ld hl, (**)", 3, Flow::Next, Operand::Word}, /* 2A */
+        {"dec hl", 1, Flow::Next, Operand::None}, /* 2B */
+        {"inc l", 1, Flow::Next, Operand::None}, /* 2C */
+        {"dec l", 1, Flow::Next, Operand::None}, /* 2D */
+        {"ld l, *", 2, Flow::Next, Operand::Byte}, /* 2E */
+        {"cpl", 1, Flow::Next, Operand::None}, /* 2F */
+        {"jr nc, *", 2, Flow::Branch, Operand::Relative}, /* 30 */
+        {"ld sp, **", 3, Flow::Next, Operand::Word}, /* 31 */
+        {"ld (**), a", 3, Flow::Next, Operand::Word}, /* 32 */
+        {"inc sp", 1, Flow::Next, Operand::None}, /* 33 */
+        {"inc (hl)", 1, Flow::Next, Operand::None}, /* 34 */
+        {"dec (hl)", 1, Flow::Next, Operand::None}, /* 35 */
+        {"ld (hl), *", 2, Flow::Next, Operand::Byte}, /* 36 */
+        {"scf", 1, Flow::Next, Operand::None}, /* 37 */
+        {"jr c, *", 2, Flow::Branch, Operand::Relative}, /* 38 */
+        {"add hl, sp", 1, Flow::Next, Operand::None}, /* 39 */
+        {"ld a, (**)", 3, Flow::Next, Operand::Word}, /* 3A */
+        {"dec sp", 1, Flow::Next, Operand::None}, /* 3B */
+        {"inc a", 1, Flow::Next, Operand::None}, /* 3C */
+        {"dec a", 1, Flow::Next, Operand::None}, /* 3D */
+        {"ld a, *", 2, Flow::Next, Operand::Byte}, /* 3E */
+        {"ccf", 1, Flow::Next, Operand::None}, /* 3F */
+        {"ld b, b", 1, Flow::Next, Operand::None}, /* 40 */
+        {"ld b, c", 1, Flow::Next, Operand::None}, /* 41 */
+        {"ld b, d", 1, Flow::Next, Operand::None}, /* 42 */
+        {"ld b, e", 1, Flow::Next, Operand::None}, /* 43 */
+        {"ld b, h", 1, Flow::Next, Operand::None}, /* 44 */
+        {"ld b, l", 1, Flow::Next, Operand::None}, /* 45 */
+        {"ld b, (hl)", 1, Flow::Next, Operand::None}, /* 46 */
+        {"ld b, a", 1, Flow::Next, Operand::None}, /* 47 */
+        {"ld c, b", 1, Flow::Next, Operand::None}, /* 48 */
+        {"ld c, c", 1, Flow::Next, Operand::None}, /* 49 */
+        {"ld c, d", 1, Flow::Next, Operand::None}, /* 4A */
+        {"ld c, e", 1, Flow::Next, Operand::None}, /* 4B */
+        {"ld c, h", 1, Flow::Next, Operand::None}, /* 4C */
+        {"ld c, l", 1, Flow::Next, Operand::None}, /* 4D */
+        {"ld c, (hl)", 1, Flow::Next, Operand::None}, /* 4E */
+        {"ld c, a", 1, Flow::Next, Operand::None}, /* 4F */
+        {"ld d, b", 1, Flow::Next, Operand::None}, /* 50 */
+        {"ld d, c", 1, Flow::Next, Operand::None}, /* 51 */
+        {"ld d, d", 1, Flow::Next, Operand::None}, /* 52 */
+        {"ld d, e", 1, Flow::Next, Operand::None}, /* 53 */
+        {"ld d, h", 1, Flow::Next, Operand::None}, /* 54 */
+        {"ld d, l", 1, Flow::Next, Operand::None}, /* 55 */
+        {"ld d, (hl)", 1, Flow::Next, Operand::None}, /* 56 */
+        {"ld d, a", 1, Flow::Next, Operand::None}, /* 57 */
+        {"ld e, b", 1, Flow::Next, Operand::None}, /* 58 */
+        {"ld e, c", 1, Flow::Next, Operand::None}, /* 59 */
+        {"ld e, d", 1, Flow::Next, Operand::None}, /* 5A */
+        {"ld e, e", 1, Flow::Next, Operand::None}, /* 5B */
+        {"ld e, h", 1, Flow::Next, Operand::None}, /* 5C */
+        {"ld e, l", 1, Flow::Next, Operand::None}, /* 5D */
+        {"ld e, (hl)", 1, Flow::Next, Operand::None}, /* 5E */
+        {"ld e, a", 1, Flow::Next, Operand::None}, /* 5F */
+        {"ld h, b", 1, Flow::Next, Operand::None}, /* 60 */
+        {"ld h, c", 1, Flow::Next, Operand::None}, /* 61 */
+        {"ld h, d", 1, Flow::Next, Operand::None}, /* 62 */
+        {"ld h, e", 1, Flow::Next, Operand::None}, /* 63 */
+        {"ld h, h", 1, Flow::Next, Operand::None}, /* 64 */
+        {"ld h, l", 1, Flow::Next, Operand::None}, /* 65 */
+        {"ld h, (hl)", 1, Flow::Next, Operand::None}, /* 66 */
+        {"ld h, a", 1, Flow::Next, Operand::None}, /* 67 */
+        {"ld l, b", 1, Flow::Next, Operand::None}, /* 68 */
+        {"ld l, c", 1, Flow::Next, Operand::None}, /* 69 */
+        {"ld l, d", 1, Flow::Next, Operand::None}, /* 6A */
+        {"ld l, e", 1, Flow::Next, Operand::None}, /* 6B */
+        {"ld l, h", 1, Flow::Next, Operand::None}, /* 6C */
+        {"ld l, l", 1, Flow::Next, Operand::None}, /* 6D */
+        {"ld l, (hl)", 1, Flow::Next, Operand::None}, /* 6E */
+        {"ld l, a", 1, Flow::Next, Operand::None}, /* 6F */
+        {"ld (hl), b", 1, Flow::Next, Operand::None}, /* 70 */
+        {"ld (hl), c", 1, Flow::Next, Operand::None}, /* 71 */
+        {"ld (hl), d", 1, Flow::Next, Operand::None}, /* 72 */
+        {"ld (hl), e", 1, Flow::Next, Operand::None}, /* 73 */
+        {"ld (hl), h", 1, Flow::Next, Operand::None}, /* 74 */
+        {"ld (hl), l", 1, Flow::Next, Operand::None}, /* 75 */
+        {"halt", 1, Flow::Halt, Operand::None}, /* 76 */
+        {"ld (hl), a", 1, Flow::Next, Operand::None}, /* 77 */
+        {"ld a, b", 1, Flow::Next, Operand::None}, /* 78 */
+        {"ld a, c", 1, Flow::Next, Operand::None}, /* 79 */
+        {"ld a, d", 1, Flow::Next, Operand::None}, /* 7A */
+        {"ld a, e", 1, Flow::Next, Operand::None}, /* 7B */
+        {"ld a, h", 1, Flow::Next, Operand::None}, /* 7C */
+        {"ld a, l", 1, Flow::Next, Operand::None}, /* 7D */
+        {"ld a, (hl)", 1, Flow::Next, Operand::None}, /* 7E */
+        {"ld a, a", 1, Flow::Next, Operand::None}, /* 7F */
+        {"add a, b", 1, Flow::Next, Operand::None}, /* 80 */
+        {"add a, c", 1, Flow::Next, Operand::None}, /* 81 */
+        {"add a, d", 1, Flow::Next, Operand::None}, /* 82 */
+        {"add a, e", 1, Flow::Next, Operand::None}, /* 83 */
+        {"add a, h", 1, Flow::Next, Operand::None}, /* 84 */
+        {"add a, l", 1, Flow::Next, Operand::None}, /* 85 */
+        {"add a, (hl)", 1, Flow::Next, Operand::None}, /* 86 */
+        {"add a, a", 1, Flow::Next, Operand::None}, /* 87 */
+        {"adc a, b", 1, Flow::Next, Operand::None}, /* 88 */
+        {"adc a, c", 1, Flow::Next, Operand::None}, /* 89 */
+        {"adc a, d", 1, Flow::Next, Operand::None}, /* 8A */
+        {"adc a, e", 1, Flow::Next, Operand::None}, /* 8B */
+        {"adc a, h", 1, Flow::Next, Operand::None}, /* 8C */
+        {"adc a, l", 1, Flow::Next, Operand::None}, /* 8D */
+        {"adc a, (hl)", 1, Flow::Next, Operand::None}, /* 8E */
+        {"adc a, a", 1, Flow::Next, Operand::None}, /* 8F */
+        {"sub b", 1, Flow::Next, Operand::None}, /* 90 */
+        {"sub c", 1, Flow::Next, Operand::None}, /* 91 */
+        {"sub d", 1, Flow::Next, Operand::None}, /* 92 */
+        {"sub e", 1, Flow::Next, Operand::None}, /* 93 */
+        {"sub h", 1, Flow::Next, Operand::None}, /* 94 */
+        {"sub l", 1, Flow::Next, Operand::None}, /* 95 */
+        {"sub (hl)", 1, Flow::Next, Operand::None}, /* 96 */
+        {"sub a", 1, Flow::Next, Operand::None}, /* 97 */
+        {"sbc a, b", 1, Flow::Next, Operand::None}, /* 98 */
+        {"sbc a, c", 1, Flow::Next, Operand::None}, /* 99 */
+        {"sbc a, d", 1, Flow::Next, Operand::None}, /* 9A */
+        {"sbc a, e", 1, Flow::Next, Operand::None}, /* 9B */
+        {"sbc a, h", 1, Flow::Next, Operand::None}, /* 9C */
+        {"sbc a, l", 1, Flow::Next, Operand::None}, /* 9D */
+        {"sbc a, (hl)", 1, Flow::Next, Operand::None}, /* 9E */
+        {"sbc a, a", 1, Flow::Next, Operand::None}, /* 9F */
+        {"and b", 1, Flow::Next, Operand::None}, /* A0 */
+        {"and c", 1, Flow::Next, Operand::None}, /* A1 */
+        {"and d", 1, Flow::Next, Operand::None}, /* A2 */
+        {"and e", 1, Flow::Next, Operand::None}, /* A3 */
+        {"and h", 1, Flow::Next, Operand::None}, /* A4 */
+        {"and l", 1, Flow::Next, Operand::None}, /* A5 */
+        {"and (hl)", 1, Flow::Next, Operand::None}, /* A6 */
+        {"and a", 1, Flow::Next, Operand::None}, /* A7 */
+        {"xor b", 1, Flow::Next, Operand::None}, /* A8 */
+        {"xor c", 1, Flow::Next, Operand::None}, /* A9 */
+        {"xor d", 1, Flow::Next, Operand::None}, /* AA */
+        {"xor e", 1, Flow::Next, Operand::None}, /* AB */
+        {"xor h", 1, Flow::Next, Operand::None}, /* AC */
+        {"xor l", 1, Flow::Next, Operand::None}, /* AD */
+        {"xor (hl)", 1, Flow::Next, Operand::None}, /* AE */
+        {"xor a", 1, Flow::Next, Operand::None}, /* AF */
+        {"or b", 1, Flow::Next, Operand::None}, /* B0 */
+        {"or c", 1, Flow::Next, Operand::None}, /* B1 */
+        {"or d", 1, Flow::Next, Operand::None}, /* B2 */
+        {"or e", 1, Flow::Next, Operand::None}, /* B3 */
+        {"or h", 1, Flow::Next, Operand::None}, /* B4 */
+        {"or l", 1, Flow::Next, Operand::None}, /* B5 */
+        {"or (hl)", 1, Flow::Next, Operand::None}, /* B6 */
+        {"or a", 1, Flow::Next, Operand::None}, /* B7 */
+        {"cp b", 1, Flow::Next, Operand::None}, /* B8 */
+        {"cp c", 1, Flow::Next, Operand::None}, /* B9 */
+        {"cp d", 1, Flow::Next, Operand::None}, /* BA */
+        {"cp e", 1, Flow::Next, Operand::None}, /* BB */
+        {"cp h", 1, Flow::Next, Operand::None}, /* BC */
+        {"cp l", 1, Flow::Next, Operand::None}, /* BD */
+        {"cp (hl)", 1, Flow::Next, Operand::None}, /* BE */
+        {"cp a", 1, Flow::Next, Operand::None}, /* BF */
+        {"ret nz", 1, Flow::CondReturn, Operand::None}, /* C0 */
+        {"pop bc", 1, Flow::Next, Operand::None}, /* C1 */
+        {"jp nz, **", 3, Flow::Branch, Operand::Word}, /* C2 */
+        {"jp **", 3, Flow::Jump, Operand::Word}, /* C3 */
+        {"call nz, **", 3, Flow::CondCall, Operand::Word}, /* C4 */
+        {"push bc", 1, Flow::Next, Operand::None}, /* C5 */
+        {"add a, *", 2, Flow::Next, Operand::Byte}, /* C6 */
+        {"rst 00h", 1, Flow::Restart, Operand::None}, /* C7 */
+        {"ret z", 1, Flow::CondReturn, Operand::None}, /* C8 */
+        {"ret", 1, Flow::Return, Operand::None}, /* C9 */
+        {"jp z, **", 3, Flow::Branch, Operand::Word}, /* CA */
+        {"prefix cb", 1, Flow::Next, Operand::None}, /* CB */
+        {"call z, **", 3, Flow::CondCall, Operand::Word}, /* CC */
+        {"call **", 3, Flow::Call, Operand::Word}, /* CD */
+        {"adc a, *", 2, Flow::Next, Operand::Byte}, /* CE */
+        {"rst 08h", 1, Flow::Restart, Operand::None}, /* CF */
+        {"ret nc", 1, Flow::CondReturn, Operand::None}, /* D0 */
+        {"pop de", 1, Flow::Next, Operand::None}, /* D1 */
+        {"jp nc, **", 3, Flow::Branch, Operand::Word}, /* D2 */
+        {"out (*), a", 2, Flow::Next, Operand::Byte}, /* D3 */
+        {"call nc, **", 3, Flow::CondCall, Operand::Word}, /* D4 */
+        {"push de", 1, Flow::Next, Operand::None}, /* D5 */
+        {"sub *", 2, Flow::Next, Operand::Byte}, /* D6 */
+        {"rst 10h", 1, Flow::Restart, Operand::None}, /* D7 */
+        {"ret c", 1, Flow::CondReturn, Operand::None}, /* D8 */
+        {"exx", 1, Flow::Next, Operand::None}, /* D9 */
+        {"jp c, **", 3, Flow::Branch, Operand::Word}, /* DA */
+        {"in a, (*)", 2, Flow::Next, Operand::Byte}, /* DB */
+        {"call c, **", 3, Flow::CondCall, Operand::Word}, /* DC */
+        {"prefix dd", 1, Flow::Next, Operand::None}, /* DD */
+        {"sbc a, *", 2, Flow::Next, Operand::Byte}, /* DE */
+        {"rst 18h", 1, Flow::Restart, Operand::None}, /* DF */
+        {"ret po", 1, Flow::CondReturn, Operand::None}, /* E0 */
+        {"pop hl", 1, Flow::Next, Operand::None}, /* E1 */
+        {"jp po, **", 3, Flow::Branch, Operand::Word}, /* E2 */
+        {"ex (sp), hl", 1, Flow::Next, Operand::None}, /* E3 */
+        {"call po, **", 3, Flow::CondCall, Operand::Word}, /* E4 */
+        {"push hl", 1, Flow::Next, Operand::None}, /* E5 */
+        {"and *", 2, Flow::Next, Operand::Byte}, /* E6 */
+        {"rst 20h", 1, Flow::Restart, Operand::None}, /* E7 */
+        {"ret pe", 1, Flow::CondReturn, Operand::None}, /* E8 */
+        {"jp (hl)", 1, Flow::Indirect, Operand::None}, /* E9 */
+        {"jp pe, **", 3, Flow::Branch, Operand::Word}, /* EA */
+        {"ex de, hl", 1, Flow::Next, Operand::None}, /* EB */
+        {"call pe, **", 3, Flow::CondCall, Operand::Word}, /* EC */
+        {"prefix ed", 1, Flow::Next, Operand::None}, /* ED */
+        {"xor *", 2, Flow::Next, Operand::Byte}, /* EE */
+        {"rst 28h", 1, Flow::Restart, Operand::None}, /* EF */
+        {"ret p", 1, Flow::CondReturn, Operand::None}, /* F0 */
+        {"pop af", 1, Flow::Next, Operand::None}, /* F1 */
+        {"jp p, **", 3, Flow::Branch, Operand::Word}, /* F2 */
+        {"di", 1, Flow::Next, Operand::None}, /* F3 */
+        {"call p, **", 3, Flow::CondCall, Operand::Word}, /* F4 */
+        {"push af", 1, Flow::Next, Operand::None}, /* F5 */
+        {"or *", 2, Flow::Next, Operand::Byte}, /* F6 */
+        {"rst 30h", 1, Flow::Restart, Operand::None}, /* F7 */
+        {"ret m", 1, Flow::CondReturn, Operand::None}, /* F8 */
+        {"ld sp, hl", 1, Flow::Next, Operand::None}, /* F9 */
+        {"jp m, **", 3, Flow::Branch, Operand::Word}, /* FA */
+        {"ei", 1, Flow::Next, Operand::None}, /* FB */
+        {"call m, **", 3, Flow::CondCall, Operand::Word}, /* FC */
+        {"prefix fd", 1, Flow::Next, Operand::None}, /* FD */
+        {"cp *", 2, Flow::Next, Operand::Byte}, /* FE */
+        {"rst 38h", 1, Flow::Restart, Operand::None}  /* FF */
+    };
+
+    /* ED prefixed instructions, the missing ones behave as two byte nops */
+    const OpcodeInfo extended_opcodes[256] =
+    {
+        {nullptr, 2, Flow::Next, Operand::None}, /* 00 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 01 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 02 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 03 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 04 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 05 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 06 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 07 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 08 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 09 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 0F */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 10 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 11 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 12 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 13 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 14 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 15 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 16 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 17 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 18 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 19 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 1F */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 20 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 21 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 22 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 23 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 24 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 25 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 26 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 27 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 28 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 29 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 2F */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 30 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 31 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 32 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 33 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 34 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 35 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 36 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 37 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 38 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 39 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 3F */
+        {"in b, (c)", 2, Flow::Next, Operand::None}, /* 40 */
+        {"out (c), b", 2, Flow::Next, Operand::None}, /* 41 */
+        {"sbc hl, bc", 2, Flow::Next, Operand::None}, /* 42 */
+        {"ld (**), bc", 4, Flow::Next, Operand::Word}, /* 43 */
+        {"neg", 2, Flow::Next, Operand::None}, /* 44 */
+        {"retn", 2, Flow::Return, Operand::None}, /* 45 */
+        {"im 0", 2, Flow::Next, Operand::None}, /* 46 */
+        {"ld i, a", 2, Flow::Next, Operand::None}, /* 47 */
+        {"in c, (c)", 2, Flow::Next, Operand::None}, /* 48 */
+        {"out (c), c", 2, Flow::Next, Operand::None}, /* 49 */
+        {"adc hl, bc", 2, Flow::Next, Operand::None}, /* 4A */
+        {"ld bc, (**)", 4, Flow::Next, Operand::Word}, /* 4B */
+        {"neg", 2, Flow::Next, Operand::None}, /* 4C */
+        {"reti", 2, Flow::Return, Operand::None}, /* 4D */
+        {"im 0", 2, Flow::Next, Operand::None}, /* 4E */
+        {"ld r, a", 2, Flow::Next, Operand::None}, /* 4F */
+        {"in d, (c)", 2, Flow::Next, Operand::None}, /* 50 */
+        {"out (c), d", 2, Flow::Next, Operand::None}, /* 51 */
+        {"sbc hl, de", 2, Flow::Next, Operand::None}, /* 52 */
+        {"ld (**), de", 4, Flow::Next, Operand::Word}, /* 53 */
+        {"neg", 2, Flow::Next, Operand::None}, /* 54 */
+        {"retn", 2, Flow::Return, Operand::None}, /* 55 */
+        {"im 1", 2, Flow::Next, Operand::None}, /* 56 */
+        {"ld a, i", 2, Flow::Next, Operand::None}, /* 57 */
+        {"in e, (c)", 2, Flow::Next, Operand::None}, /* 58 */
+        {"out (c), e", 2, Flow::Next, Operand::None}, /* 59 */
+        {"adc hl, de", 2, Flow::Next, Operand::None}, /* 5A */
+        {"ld de, (**)", 4, Flow::Next, Operand::Word}, /* 5B */
+        {"neg", 2, Flow::Next, Operand::None}, /* 5C */
+        {"retn", 2, Flow::Return, Operand::None}, /* 5D */
+        {"im 2", 2, Flow::Next, Operand::None}, /* 5E */
+        {"ld a, r", 2, Flow::Next, Operand::None}, /* 5F */
+        {"in h, (c)", 2, Flow::Next, Operand::None}, /* 60 */
+        {"out (c), h", 2, Flow::Next, Operand::None}, /* 61 */
+        {"sbc hl, hl", 2, Flow::Next, Operand::None}, /* 62 */
+        {"ld (**), hl", 4, Flow::Next, Operand::Word}, /* 63 */
+        {"neg", 2, Flow::Next, Operand::None}, /* 64 */
+        {"retn", 2, Flow::Return, Operand::None}, /* 65 */
+        {"im 0", 2, Flow::Next, Operand::None}, /* 66 */
+        {"rrd", 2, Flow::Next, Operand::None}, /* 67 */
+        {"in l, (c)", 2, Flow::Next, Operand::None}, /* 68 */
+        {"out (c), l", 2, Flow::Next, Operand::None}, /* 69 */
+        {"adc hl, hl", 2, Flow::Next, Operand::None}, /* 6A */
+        {"ld hl, (**)", 4, Flow::Next, Operand::Word}, /* 6B */
+        {"neg", 2, Flow::Next, Operand::None}, /* 6C */
+        {"retn", 2, Flow::Return, Operand::None}, /* 6D */
+        {"im 0", 2, Flow::Next, Operand::None}, /* 6E */
+        {"rld", 2, Flow::Next, Operand::None}, /* 6F */
+        {"in (c)", 2, Flow::Next, Operand::None}, /* 70 */
+        {"out (c), 0", 2, Flow::Next, Operand::None}, /* 71 */
+        {"sbc hl, sp", 2, Flow::Next, Operand::None}, /* 72 */
+        {"ld (**), sp", 4, Flow::Next, Operand::Word}, /* 73 */
+        {"neg", 2, Flow::Next, Operand::None}, /* 74 */
+        {"retn", 2, Flow::Return, Operand::None}, /* 75 */
+        {"im 1", 2, Flow::Next, Operand::None}, /* 76 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 77 */
+        {"in a, (c)", 2, Flow::Next, Operand::None}, /* 78 */
+        {"out (c), a", 2, Flow::Next, Operand::None}, /* 79 */
+        {"adc hl, sp", 2, Flow::Next, Operand::None}, /* 7A */
+        {"ld sp, (**)", 4, Flow::Next, Operand::Word}, /* 7B */
+        {"neg", 2, Flow::Next, Operand::None}, /* 7C */
+        {"retn", 2, Flow::Return, Operand::None}, /* 7D */
+        {"im 2", 2, Flow::Next, Operand::None}, /* 7E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 7F */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 80 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 81 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 82 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 83 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 84 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 85 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 86 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 87 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 88 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 89 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 8F */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 90 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 91 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 92 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 93 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 94 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 95 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 96 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 97 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 98 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 99 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9A */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9B */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9C */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9D */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9E */
+        {nullptr, 2, Flow::Next, Operand::None}, /* 9F */
+        {"ldi", 2, Flow::Next, Operand::None}, /* A0 */
+        {"cpi", 2, Flow::Next, Operand::None}, /* A1 */
+        {"ini", 2, Flow::Next, Operand::None}, /* A2 */
+        {"outi", 2, Flow::Next, Operand::None}, /* A3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* A4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* A5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* A6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* A7 */
+        {"ldd", 2, Flow::Next, Operand::None}, /* A8 */
+        {"cpd", 2, Flow::Next, Operand::None}, /* A9 */
+        {"ind", 2, Flow::Next, Operand::None}, /* AA */
+        {"outd", 2, Flow::Next, Operand::None}, /* AB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* AC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* AD */
+        {nullptr, 2, Flow::Next, Operand::None}, /* AE */
+        {nullptr, 2, Flow::Next, Operand::None}, /* AF */
+        {"ldir", 2, Flow::Next, Operand::None}, /* B0 */
+        {"cpir", 2, Flow::Next, Operand::None}, /* B1 */
+        {"inir", 2, Flow::Next, Operand::None}, /* B2 */
+        {"otir", 2, Flow::Next, Operand::None}, /* B3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* B4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* B5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* B6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* B7 */
+        {"lddr", 2, Flow::Next, Operand::None}, /* B8 */
+        {"cpdr", 2, Flow::Next, Operand::None}, /* B9 */
+        {"indr", 2, Flow::Next, Operand::None}, /* BA */
+        {"otdr", 2, Flow::Next, Operand::None}, /* BB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* BC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* BD */
+        {nullptr, 2, Flow::Next, Operand::None}, /* BE */
+        {nullptr, 2, Flow::Next, Operand::None}, /* BF */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C0 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C1 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C2 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C7 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C8 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* C9 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CA */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CD */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CE */
+        {nullptr, 2, Flow::Next, Operand::None}, /* CF */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D0 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D1 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D2 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D7 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D8 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* D9 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DA */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DD */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DE */
+        {nullptr, 2, Flow::Next, Operand::None}, /* DF */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E0 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E1 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E2 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E7 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E8 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* E9 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* EA */
+        {nullptr, 2, Flow::Next, Operand::None}, /* EB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* EC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* ED */
+        {nullptr, 2, Flow::Next, Operand::None}, /* EE */
+        {nullptr, 2, Flow::Next, Operand::None}, /* EF */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F0 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F1 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F2 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F3 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F4 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F5 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F6 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F7 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F8 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* F9 */
+        {nullptr, 2, Flow::Next, Operand::None}, /* FA */
+        {nullptr, 2, Flow::Next, Operand::None}, /* FB */
+        {nullptr, 2, Flow::Next, Operand::None}, /* FC */
+        {nullptr, 2, Flow::Next, Operand::None}, /* FD */
+        {nullptr, 2, Flow::Next, Operand::None}, /* FE */
+        {nullptr, 2, Flow::Next, Operand::None}  /* FF */
+    };
+
+    static const char* const register_names[] = {"b", "c", "d", "e", "h", "l", "(hl)", "a"};
+
+    static std::string hex(unsigned int value, int digits)
+    {
+        char s[8];
+        snprintf(s, sizeof(s), "%0*xh", digits, value);
+        return isalpha(s[0]) ? std::string("0") + s : s; /* 0ffh, not a label */
+    }
+
+    /* Replaces the first occurrence of the word from */
+    static bool replace_word(std::string& s, const std::string& from, const std::string& to)
+    {
+        for(size_t pos = s.find(from); pos != std::string::npos; pos = s.find(from, pos + 1))
+        {
+            bool start = pos == 0 || !isalnum(s[pos-1]);
+            bool end = pos + from.size() == s.size() || !isalnum(s[pos + from.size()]);
+            if(start && end)
+            {
+                s.replace(pos, from.size(), to);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* CB instructions, operand is (hl) or (ix+d) */
+    static std::string bit_mnemonic(uint8_t opcode, const std::string& operand)
+    {
+        static const char* const rotations[] = {"rlc", "rrc", "rl", "rr", "sla", "sra", "sll", "srl"};
+        static const char* const operations[] = {"", "bit", "res", "set"};
+        unsigned int b = opcode >> 3 & 0x7;
+        std::string target = (opcode & 0x7) == 0x6 ? operand : register_names[opcode & 0x7];
+
+        if(opcode >> 6 == 0)
+            return std::string(rotations[b]) + " " + target;
+        return std::string(operations[opcode >> 6]) + " " + std::to_string(b) + ", " + target;
+    }
+
+    bool decode(const uint8_t* code, unsigned int size, uint16_t address, Instruction& instruction)
+    {
+        auto fits = [&](unsigned int length) { return address + length <= size; };
+
+        if(!fits(1))
+            return false;
+
+        uint8_t opcode = code[address];
+        OpcodeInfo info = main_opcodes[opcode];
+        std::string mnemonic;
+        unsigned int operand_at = 1; /* Offset of the immediate operand */
+
+        if(opcode == 0xCB)
+        {
+            if(!fits(2))
+                return false;
+            mnemonic = bit_mnemonic(code[address+1], "(hl)");
+            info.length = 2;
+        }
+        else if(opcode == 0xED)
+        {
+            if(!fits(2))
+                return false;
+            info = extended_opcodes[code[address+1]];
+            mnemonic = info.mnemonic ? info.mnemonic : "db 0edh, " + hex(code[address+1], 2);
+            operand_at = 2;
+        }
+        else if(opcode == 0xDD || opcode == 0xFD)
+        {
+            std::string xy = opcode == 0xDD ? "ix" : "iy";
+
+            if(!fits(2))
+                return false;
+            uint8_t next = code[address+1];
+            info = main_opcodes[next];
+            mnemonic = info.mnemonic;
+            operand_at = 2;
+
+            if(next == 0xCB)
+            {
+                if(!fits(4))
+                    return false;
+                uint8_t last = code[address+3];
+                int8_t displacement = code[address+2];
+                std::string memory = "(" + xy + (displacement < 0 ? "-" : "+") + hex(displacement < 0 ? -displacement : displacement, 2) + ")";
+
+                mnemonic = bit_mnemonic(last | 0x6, memory);
+                if((last & 0x7) != 0x6 && last >> 6 != 1) /* Undocumented copy to a register */
+                    mnemonic += std::string(", ") + register_names[last & 0x7];
+                info = {nullptr, 4, Flow::Next, Operand::None};
+            }
+            else if(next == 0xCB || next == 0xDD || next == 0xED || next == 0xFD)
+            {
+                mnemonic = "db " + hex(opcode, 2); /* The prefix has no effect */
+                info = {nullptr, 1, Flow::Next, Operand::None};
+            }
+            else if(next == 0xE9)
+            {
+                mnemonic = "jp (" + xy + ")";
+                info.length++;
+            }
+            else if(mnemonic.find("(hl)") != std::string::npos)
+            {
+                if(!fits(3))
+                    return false;
+                int8_t displacement = code[address+2];
+                mnemonic.replace(mnemonic.find("(hl)"), 4, "(" + xy + (displacement < 0 ? "-" : "+") + hex(displacement < 0 ? -displacement : displacement, 2) + ")");
+                info.length += 2;
+                operand_at = 3;
+            }
+            else
+            {
+                /* ex de, hl keeps hl, h and l become the undocumented halves */
+                if(next != 0xEB && replace_word(mnemonic, "hl", xy))
+                    replace_word(mnemonic, "hl", xy); /* add ix, ix */
+                else if(next != 0xEB)
+                {
+                    while(replace_word(mnemonic, "h", xy + "h"));
+                    while(replace_word(mnemonic, "l", xy + "l"));
+                }
+                info.length++;
+            }
+        }
+        else
+            mnemonic = info.mnemonic;
+
+        if(!fits(info.length))
+            return false;
+
+        instruction.address = address;
+        instruction.length = info.length;
+        instruction.flow = info.flow;
+        instruction.target = 0;
+
+        unsigned int value = 0;
+        switch(info.operand)
+        {
+            case Operand::None:
+                break;
+            case Operand::Byte:
+                value = code[address + operand_at];
+                mnemonic.replace(mnemonic.find('*'), 1, hex(value, 2));
+                break;
+            case Operand::Word:
+                value = code[address + operand_at] | code[address + operand_at + 1] << 8;
+                mnemonic.replace(mnemonic.find("**"), 2, hex(value, 4));
+                instruction.target = value;
+                break;
+            case Operand::Relative:
+                instruction.target = address + info.length + static_cast<int8_t>(code[address + operand_at]);
+                mnemonic.replace(mnemonic.find('*'), 1, hex(instruction.target, 4));
+                break;
+        }
+        if(info.flow == Flow::Restart)
+            instruction.target = code[address + info.length - 1] & 0x38; /* The opcode, past any prefix */
+
+        snprintf(instruction.text, sizeof(instruction.text), "%s", mnemonic.c_str());
+        return true;
+    }
+}
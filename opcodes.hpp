@@ -0,0 +1,51 @@
+#ifndef Z80_OPCODES_H
+#define Z80_OPCODES_H
+
+#include<cstdint>
+
+namespace Z80
+{
+    /* Where execution goes after an instruction */
+    enum class Flow : uint8_t
+    {
+        Next,       /* Following instruction */
+        Jump,       /* Target only */
+        Branch,     /* Target or following instruction */
+        Call,
+        CondCall,
+        Return,
+        CondReturn,
+        Restart,    /* Call to opcode & 0x38 */
+        Indirect,   /* jp (hl), jp (ix), jp (iy) */
+        Halt        /* Following instruction, once interrupted */
+    };
+
+    /* What the * or ** of a mnemonic stands for */
+    enum class Operand : uint8_t { None, Byte, Word, Relative };
+
+    struct OpcodeInfo
+    {
+        const char* mnemonic; /* Null for the ED opcodes which do nothing */
+        uint8_t length;
+        Flow flow;
+        Operand operand;
+    };
+
+    /* Shared by the interpreter traces and the analyzer */
+    extern const OpcodeInfo main_opcodes[256];
+    extern const OpcodeInfo extended_opcodes[256];
+
+    struct Instruction
+    {
+        uint16_t address;
+        uint8_t length;
+        Flow flow;
+        uint16_t target;  /* Of jumps, calls and restarts */
+        char text[24];
+    };
+
+    /* Decodes the instruction at address, false if it goes past the end of code */
+    bool decode(const uint8_t* code, unsigned int size, uint16_t address, Instruction& instruction);
+}
+
+#endif
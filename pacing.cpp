@@ -0,0 +1,89 @@
+#include<cmath>
+#include<algorithm>
+#include<thread>
+
+#include "pacing.hpp"
+
+namespace Z80
+{
+    void Pacer::wait()
+    {
+        clock::time_point now = clock::now();
+
+        if(!started)
+        {
+            deadline = now;
+            started = true;
+        }
+        deadline += period;
+        stats.frames++;
+
+        if(now >= deadline)
+        {
+            stats.late++;
+            if(now - deadline > period * max_behind)
+            {
+                stats.skipped += (now - deadline) / period;
+                deadline = now;
+            }
+            publish();
+            return;
+        }
+
+        if(deadline - now > spin)
+            std::this_thread::sleep_until(deadline - spin);
+        while((now = clock::now()) < deadline)
+            ;
+
+        double error = std::chrono::duration<double, std::micro>(now - deadline).count();
+        on_time++;
+        error_sum += error;
+        error_squares += error * error;
+        stats.mean_error = error_sum / on_time;
+        stats.max_error = std::max(stats.max_error, error);
+        stats.jitter = std::sqrt(std::max(0.0, error_squares / on_time - stats.mean_error * stats.mean_error));
+        publish();
+    }
+
+    void Pacer::reset()
+    {
+        started = false;
+    }
+
+    void Pacer::publish()
+    {
+        uint32_t start = sequence.load(std::memory_order_relaxed);
+        sequence.store(start + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        published_frames.store(stats.frames, std::memory_order_relaxed);
+        published_late.store(stats.late, std::memory_order_relaxed);
+        published_skipped.store(stats.skipped, std::memory_order_relaxed);
+        published_mean.store(stats.mean_error, std::memory_order_relaxed);
+        published_max.store(stats.max_error, std::memory_order_relaxed);
+        published_jitter.store(stats.jitter, std::memory_order_relaxed);
+
+        sequence.store(start + 2, std::memory_order_release);
+    }
+
+    Pacer::Statistics Pacer::statistics() const
+    {
+        Statistics copy;
+        uint32_t before, after;
+
+        do
+        {
+            before = sequence.load(std::memory_order_acquire);
+            copy.frames = published_frames.load(std::memory_order_relaxed);
+            copy.late = published_late.load(std::memory_order_relaxed);
+            copy.skipped = published_skipped.load(std::memory_order_relaxed);
+            copy.mean_error = published_mean.load(std::memory_order_relaxed);
+            copy.max_error = published_max.load(std::memory_order_relaxed);
+            copy.jitter = published_jitter.load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while(before != after || (before & 1));
+
+        return copy;
+    }
+}
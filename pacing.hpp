@@ -0,0 +1,62 @@
+#ifndef Z80_PACING_H
+#define Z80_PACING_H
+
+#include<cstdint>
+#include<chrono>
+#include<atomic>
+
+namespace Z80
+{
+    /* Real-time pacing of frames. Each frame has an absolute deadline, one
+     * period after the previous one, so lateness does not add up. The
+     * pacer sleeps until shortly before the deadline and spins the rest of
+     * the way, as sleeps overshoot by up to the scheduler's granularity.
+     * Frames which end late start the next one at once to catch up; falling
+     * more than max_behind periods behind gives up on the missed frames.
+     * statistics() may be called from any thread; it reads a consistent copy
+     * published by wait() under a sequence lock. */
+    class Pacer
+    {
+        public:
+            using clock = std::chrono::steady_clock;
+
+            struct Statistics
+            {
+                uint64_t frames = 0;
+                uint64_t late = 0;       /* Frames which ended after their deadline */
+                uint64_t skipped = 0;    /* Deadlines given up after falling behind */
+                double mean_error = 0;   /* Microseconds between deadlines and wake ups */
+                double max_error = 0;
+                double jitter = 0;       /* Standard deviation of the error */
+            };
+
+            void set_period(clock::duration period) { this->period = period; }
+            void set_spin(clock::duration spin) { this->spin = spin; }     /* Spun rather than slept before a deadline */
+            void set_max_behind(unsigned int frames) { max_behind = frames; }
+
+            void wait(); /* Until the end of the current frame */
+            void reset(); /* Next wait() starts from the present */
+            Statistics statistics() const;
+
+        private:
+            clock::duration period = std::chrono::microseconds(16667);
+            clock::duration spin = std::chrono::microseconds(500);
+            unsigned int max_behind = 3;
+
+            bool started = false;
+            clock::time_point deadline;
+
+            Statistics stats; /* Owned by the thread calling wait() */
+            double error_sum = 0, error_squares = 0;
+            uint64_t on_time = 0;
+
+            /* Copy of stats for other threads, odd sequence while it is written */
+            std::atomic<uint32_t> sequence{0};
+            std::atomic<uint64_t> published_frames{0}, published_late{0}, published_skipped{0};
+            std::atomic<double> published_mean{0}, published_max{0}, published_jitter{0};
+
+            void publish();
+    };
+}
+
+#endif
@@ -0,0 +1,94 @@
+#include<cstdint>
+#include<cstdio>
+
+#include "profiler.hpp"
+
+namespace Z80
+{
+    void Profiler::start()
+    {
+        if(running.exchange(true))
+            return;
+        timer = std::thread(&Profiler::tick, this);
+    }
+
+    void Profiler::stop()
+    {
+        running = false;
+        if(timer.joinable())
+            timer.join();
+    }
+
+    void Profiler::tick()
+    {
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+        while(running.load(std::memory_order_relaxed))
+        {
+            next += interval; /* Absolute, so the rate does not drift */
+            std::this_thread::sleep_until(next);
+            requested.store(true, std::memory_order_relaxed);
+        }
+    }
+
+    void Profiler::record(const Sample& sample)
+    {
+        requested.store(false, std::memory_order_relaxed);
+        if(!ring.push(sample))
+            lost.store(lost.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    unsigned int Profiler::collect()
+    {
+        Sample sample;
+        unsigned int count = 0;
+        char frame[8];
+
+        while(ring.pop(sample))
+        {
+            std::string stack;
+            for(unsigned int n = sample.depth; n-- > 0;)
+            {
+                snprintf(frame, sizeof(frame), "%04x;", sample.returns[n]);
+                stack += frame;
+            }
+            snprintf(frame, sizeof(frame), "%04x", sample.pc);
+            stacks[stack + frame]++;
+            count++;
+        }
+        return count;
+    }
+
+    /* Frames are kept as addresses and only named here, off the sampling path */
+    bool Profiler::write_folded(const char* filename, const Symbols* symbols)
+    {
+        FILE* out = fopen(filename, "w");
+        if(!out)
+            return false;
+
+        collect();
+        std::map<std::string, uint64_t> named;
+        for(const auto& stack : stacks)
+        {
+            if(!symbols)
+            {
+                named[stack.first] += stack.second;
+                continue;
+            }
+
+            std::string frames;
+            for(size_t start = 0; start < stack.first.size(); start += 5) /* "xxxx;" per frame */
+            {
+                uint16_t address = std::stoul(stack.first.substr(start, 4), nullptr, 16);
+                bool caller = start + 4 < stack.first.size();
+                const char* name = symbols->find(caller ? address - 1 : address); /* A return address can be the start of the next function */
+                frames += (start ? ";" : "") + (name ? std::string(name) : stack.first.substr(start, 4));
+            }
+            named[frames] += stack.second;
+        }
+
+        for(const auto& stack : named)
+            fprintf(out, "%s %llu\n", stack.first.c_str(), (unsigned long long)stack.second);
+        return fclose(out) == 0;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef Z80_PROFILER_H
+#define Z80_PROFILER_H
+
+#include<cstdint>
+#include<atomic>
+#include<chrono>
+#include<map>
+#include<string>
+#include<thread>
+
+#include "spsc.hpp"
+#include "symbols.hpp"
+
+namespace Z80
+{
+    /* Where a CPU was when it was sampled. The Z80 keeps no frame pointer,
+     * so the callers are the words on the stack which point just after a
+     * call or a restart. */
+    struct Sample
+    {
+        static constexpr unsigned int MAX_DEPTH = 8;
+
+        uint16_t pc;
+        uint16_t sp;
+        uint8_t depth;
+        uint16_t returns[MAX_DEPTH]; /* Innermost first */
+    };
+
+    /* Sampling profiler of one CPU. A timer thread raises a flag every
+     * interval, the CPU takes a sample at its next instruction boundary and
+     * pushes it into a lock-free ring, and the exporter folds the samples
+     * into stacks for flame graphs. Give each CPU its own profiler. */
+    class Profiler
+    {
+        public:
+            Profiler(std::chrono::microseconds interval) : interval(interval) {}
+            ~Profiler() { stop(); }
+
+            void start(); /* Starts the timer thread */
+            void stop();
+
+            /* CPU side */
+            bool due() const { return requested.load(std::memory_order_relaxed); }
+            void record(const Sample& sample);
+
+            /* Exporter side */
+            unsigned int collect(); /* Folds the samples waiting in the ring, returns how many */
+            bool write_folded(const char* filename, const Symbols* symbols = nullptr); /* "caller;callee;pc count" lines, by function with symbols */
+            uint64_t dropped() const { return lost.load(std::memory_order_relaxed); } /* Samples which found the ring full */
+
+        private:
+            std::chrono::microseconds interval;
+            std::thread timer;
+            std::atomic<bool> running{false};
+            std::atomic<bool> requested{false};
+            std::atomic<uint64_t> lost{0};
+
+            SPSCQueue<Sample, 4096> ring;
+            std::map<std::string, uint64_t> stacks;
+
+            void tick();
+    };
+}
+
+#endif
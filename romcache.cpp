@@ -0,0 +1,101 @@
+#include<cstdint>
+#include<cstring>
+#include<mutex>
+#include<unordered_map>
+
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include "romcache.hpp"
+
+namespace Z80
+{
+    const unsigned int HASHED_SIZE = 0x10000; /* Larger images are banked */
+
+    static std::mutex cache_lock;
+    static std::unordered_map<uint64_t, RomImage*> by_contents;
+    static std::unordered_map<uint64_t, RomImage*> by_file;
+
+    /* FNV-1a */
+    static uint64_t hash(const void* data, size_t size, uint64_t h = 14695981039346656037ull)
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>(data);
+        for(size_t n = 0; n<size; ++n)
+            h = (h ^ bytes[n]) * 1099511628211ull;
+        return h;
+    }
+
+    static uint64_t file_key(const struct stat& st)
+    {
+        uint64_t h = hash(&st.st_dev, sizeof(st.st_dev));
+        h = hash(&st.st_ino, sizeof(st.st_ino), h);
+        h = hash(&st.st_size, sizeof(st.st_size), h);
+        return hash(&st.st_mtim, sizeof(st.st_mtim), h);
+    }
+
+    RomImage* acquire_rom(const char* filename)
+    {
+        struct stat st;
+        void* mapping = MAP_FAILED;
+
+        int fd = open(filename, O_RDONLY);
+        if(fd < 0)
+            return nullptr;
+        if(fstat(fd, &st) == 0 && st.st_size > 0 && (uint64_t)st.st_size <= UINT32_MAX)
+            mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED)
+            return nullptr;
+
+        std::lock_guard<std::mutex> lock(cache_lock);
+        bool hashed = st.st_size <= HASHED_SIZE;
+        auto& cache = hashed ? by_contents : by_file;
+        uint64_t key = hashed ? hash(mapping, st.st_size) : file_key(st);
+
+        auto found = cache.find(key);
+        if(found != cache.end()
+           && found->second->size == (unsigned int)st.st_size
+           && (!hashed || memcmp(found->second->data, mapping, st.st_size) == 0))
+        {
+            munmap(mapping, st.st_size);
+            found->second->references++;
+            return found->second;
+        }
+
+        if(!hashed)
+            madvise(mapping, st.st_size, MADV_RANDOM); /* No read-ahead into banks which may never be mapped */
+
+        RomImage* image = new RomImage{static_cast<uint8_t*>(mapping), (unsigned int)st.st_size, key, true, 1};
+        if(found == cache.end()) /* A colliding image stays out of the cache */
+            cache[key] = image;
+        return image;
+    }
+
+    RomImage* copy_rom(const RomImage& image)
+    {
+        void* mapping = mmap(nullptr, image.size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+        if(mapping == MAP_FAILED)
+            return nullptr;
+        memcpy(mapping, image.data, image.size);
+        return new RomImage{static_cast<uint8_t*>(mapping), image.size, 0, false, 1};
+    }
+
+    void release_rom(RomImage* image)
+    {
+        std::lock_guard<std::mutex> lock(cache_lock);
+        if(--image->references)
+            return;
+
+        if(image->shared)
+        {
+            auto& cache = image->size <= HASHED_SIZE ? by_contents : by_file;
+            auto found = cache.find(image->key);
+            if(found != cache.end() && found->second == image)
+                cache.erase(found);
+        }
+        munmap(image->data, image->size);
+        delete image;
+    }
+}
@@ -0,0 +1,26 @@
+#ifndef Z80_ROMCACHE_H
+#define Z80_ROMCACHE_H
+
+#include<cstdint>
+
+namespace Z80
+{
+    /* A ROM file mapped read-only once per process. Every CPU loading the
+     * same contents gets the same pages. Images which fit the 64 KB code
+     * space are found by a hash of their contents; larger ones by the
+     * identity of the file, so that hashing them does not read every bank. */
+    struct RomImage
+    {
+        uint8_t* data;
+        unsigned int size;
+        uint64_t key;
+        bool shared;             /* Read-only and maybe used by other CPUs, false for private copies */
+        unsigned int references;
+    };
+
+    RomImage* acquire_rom(const char* filename); /* Null if the file cannot be mapped */
+    RomImage* copy_rom(const RomImage& image);   /* Writable, for a CPU patching its code */
+    void release_rom(RomImage* image);           /* Unmaps the image with its last reference */
+}
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef Z80_RUNNER_H
+#define Z80_RUNNER_H
+
+#include<cstdint>
+#include<atomic>
+#include<thread>
+
+#include "z80.hpp"
+#include "savestate.hpp"
+#include "spsc.hpp"
+
+namespace Z80
+{
+    /* Runs a CPU frame after frame on its own thread. The host controls it
+     * through a lock-free queue of commands, which the thread applies
+     * between frames, so its loop never takes a lock. Between start() and
+     * stop() the CPU belongs to the thread and is only reached through the
+     * commands. Commands return false when the queue is full. A frame which
+     * stops on an unknown opcode or a breakpoint pauses the runner; stopped()
+     * tells why until the host resumes it. */
+    template <class CPU>
+    class Runner
+    {
+        public:
+            Runner(CPU& cpu) : cpu(cpu) {}
+            ~Runner() { stop(); }
+
+            void start();
+            void stop(); /* Waits for the frame being run */
+
+            bool pause();
+            bool resume();
+            bool poke(uint16_t address, uint8_t value);
+            bool set_port(uint8_t port, uint8_t value); /* Value read by in from the port */
+            bool interrupt();
+            bool snapshot(State& state); /* state is filled once wait() returns */
+
+            void wait(); /* Until every command sent so far has been applied */
+            Status stopped() const { return stopped_on.load(std::memory_order_acquire); } /* Ok while not stopped by the CPU */
+
+        private:
+            enum class Type : uint8_t { Pause, Resume, Poke, Port, Interrupt, Snapshot, Stop };
+
+            struct Command
+            {
+                Type type;
+                uint8_t value;
+                uint16_t address;
+                State* state;
+            };
+
+            CPU& cpu;
+            std::thread thread;
+            SPSCQueue<Command, 256> commands;
+
+            uint64_t sent = 0;               /* Host side */
+            std::atomic<uint64_t> applied{0};
+            std::atomic<Status> stopped_on{Status::Ok};
+            bool paused = false;             /* Thread side */
+            bool stopping = false;
+
+            bool send(Type type, uint16_t address = 0, uint8_t value = 0, State* state = nullptr);
+            void loop();
+            void apply(const Command& command);
+    };
+}
+
+#include "runner.tpp"
+
+#endif
@@ -0,0 +1,127 @@
+#include<chrono>
+
+namespace Z80
+{
+    template <class CPU>
+    void Runner<CPU>::start()
+    {
+        if(thread.joinable())
+            return;
+        stopping = false;
+        thread = std::thread(&Runner::loop, this);
+    }
+
+    template <class CPU>
+    void Runner<CPU>::stop()
+    {
+        if(!thread.joinable())
+            return;
+        while(!send(Type::Stop))
+            std::this_thread::yield();
+        thread.join();
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::pause()
+    {
+        return send(Type::Pause);
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::resume()
+    {
+        return send(Type::Resume);
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::poke(uint16_t address, uint8_t value)
+    {
+        return send(Type::Poke, address, value);
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::set_port(uint8_t port, uint8_t value)
+    {
+        return send(Type::Port, port, value);
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::interrupt()
+    {
+        return send(Type::Interrupt);
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::snapshot(State& state)
+    {
+        return send(Type::Snapshot, 0, 0, &state);
+    }
+
+    template <class CPU>
+    void Runner<CPU>::wait()
+    {
+        while(applied.load(std::memory_order_acquire) < sent)
+            std::this_thread::yield();
+    }
+
+    template <class CPU>
+    bool Runner<CPU>::send(Type type, uint16_t address, uint8_t value, State* state)
+    {
+        if(!commands.push(Command{type, value, address, state}))
+            return false;
+        sent++;
+        return true;
+    }
+
+    template <class CPU>
+    void Runner<CPU>::loop()
+    {
+        Command command;
+
+        while(!stopping)
+        {
+            while(commands.pop(command))
+            {
+                apply(command);
+                applied.fetch_add(1, std::memory_order_release);
+            }
+
+            if(paused)
+                std::this_thread::sleep_for(std::chrono::milliseconds(1)); /* Only the queue is polled */
+            else if(!stopping)
+            {
+                Status status = cpu.step();
+                if(status != Status::BudgetExhausted) /* The next frame would fail on the same opcode again */
+                {
+                    paused = true;
+                    stopped_on.store(status, std::memory_order_release);
+                }
+            }
+        }
+    }
+
+    template <class CPU>
+    void Runner<CPU>::apply(const Command& command)
+    {
+        switch(command.type)
+        {
+            case Type::Pause:
+                paused = true; break;
+            case Type::Resume:
+                paused = false;
+                stopped_on.store(Status::Ok, std::memory_order_release);
+                cpu.get_pacer().reset(); /* The pause is not a delay to catch up on */
+                break;
+            case Type::Poke:
+                cpu.poke(command.address, command.value); break;
+            case Type::Port:
+                cpu.set_port(command.address, command.value); break;
+            case Type::Interrupt:
+                cpu.interrupt(); break;
+            case Type::Snapshot:
+                cpu.save_state(*command.state); break;
+            case Type::Stop:
+                stopping = true; break;
+        }
+    }
+}
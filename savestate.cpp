@@ -0,0 +1,176 @@
+#include<cstdint>
+#include<cstring>
+#include<cstdio>
+#include<fstream>
+#include<algorithm>
+
+#include<fcntl.h>
+#include<unistd.h>
+#include<sys/mman.h>
+#include<sys/stat.h>
+
+#include "savestate.hpp"
+
+namespace Z80
+{
+    unsigned int state_compress(const uint8_t* src, unsigned int size, uint8_t* dst)
+    {
+        const unsigned int hash_size = 4096;
+        unsigned int last_seen[hash_size];
+        unsigned int out = 0;
+        unsigned int literals = 0; /* Start of the pending literal run */
+        unsigned int pos = 0;
+
+        memset(last_seen, 0xFF, sizeof(last_seen));
+
+        auto flush_literals = [&](unsigned int end)
+        {
+            while(literals < end)
+            {
+                unsigned int run = std::min(end - literals, 128u);
+                dst[out++] = run - 1;
+                memcpy(dst + out, src + literals, run);
+                out += run;
+                literals += run;
+            }
+        };
+
+        while(pos + 3 <= size)
+        {
+            unsigned int hash = ((src[pos] << 16 | src[pos+1] << 8 | src[pos+2]) * 2654435761u) >> 20;
+            unsigned int candidate = last_seen[hash];
+            last_seen[hash] = pos;
+
+            if(candidate != 0xFFFFFFFF && pos - candidate < 65536 && memcmp(src + candidate, src + pos, 3) == 0)
+            {
+                unsigned int length = 3;
+                while(length < 130 && pos + length < size && src[candidate + length] == src[pos + length])
+                    length++;
+
+                flush_literals(pos);
+                dst[out++] = 0x80 | (length - 3);
+                dst[out++] = (pos - candidate) & 0xFF;
+                dst[out++] = (pos - candidate) >> 8;
+                pos += length;
+                literals = pos;
+            }
+            else
+                pos++;
+        }
+        flush_literals(size);
+
+        return out;
+    }
+
+    bool state_decompress(const uint8_t* src, unsigned int size, uint8_t* dst, unsigned int dst_size)
+    {
+        unsigned int in = 0;
+        unsigned int out = 0;
+
+        while(in < size)
+        {
+            uint8_t token = src[in++];
+            if(token < 0x80)
+            {
+                unsigned int run = token + 1;
+                if(in + run > size || out + run > dst_size)
+                    return false;
+                memcpy(dst + out, src + in, run);
+                in += run;
+                out += run;
+            }
+            else
+            {
+                unsigned int length = (token & 0x7F) + 3;
+                if(in + 2 > size)
+                    return false;
+                unsigned int distance = src[in] | src[in+1] << 8;
+                in += 2;
+                if(distance == 0 || distance > out || out + length > dst_size)
+                    return false;
+                for(unsigned int n = 0; n<length; ++n, ++out) /* Source and destination may overlap */
+                    dst[out] = dst[out - distance];
+            }
+        }
+
+        return out == dst_size;
+    }
+
+    bool write_state(const char* filename, const State& state, bool compress)
+    {
+        uint8_t* compressed = nullptr;
+        const uint8_t* payload = reinterpret_cast<const uint8_t*>(&state);
+        StateHeader header = {{'Z', '8', '0', 'S'}, STATE_VERSION, STATE_BYTE_ORDER, 0, 0, sizeof(State)};
+
+        if(compress)
+        {
+            compressed = new uint8_t[sizeof(State) + sizeof(State)/128 + 1];
+            header.payload_size = state_compress(payload, sizeof(State), compressed);
+            header.flags |= STATE_COMPRESSED;
+            payload = compressed;
+        }
+
+        std::ofstream file(filename, std::ios::binary|std::ios::trunc);
+        if(file.is_open())
+        {
+            file.write(reinterpret_cast<char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(payload), header.payload_size);
+        }
+        else
+            printf("Cannot write to: %s\n", filename);
+
+        bool ok = file.good();
+        delete[] compressed;
+        return ok;
+    }
+
+    StateFile::StateFile(const char* filename)
+    {
+        int fd = open(filename, O_RDONLY);
+        if(fd < 0)
+        {
+            printf("No such file: %s\n", filename);
+            return;
+        }
+
+        struct stat st;
+        if(fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(StateHeader))
+        {
+            close(fd);
+            return;
+        }
+
+        mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if(mapping == MAP_FAILED)
+        {
+            mapping = nullptr;
+            return;
+        }
+        mapping_size = st.st_size;
+
+        const StateHeader* header = static_cast<const StateHeader*>(mapping);
+        const uint8_t* payload = static_cast<const uint8_t*>(mapping) + sizeof(StateHeader);
+        if(memcmp(header->magic, "Z80S", 4) != 0
+           || header->version != STATE_VERSION
+           || header->byte_order != STATE_BYTE_ORDER
+           || header->payload_size > mapping_size - sizeof(StateHeader))
+            return;
+
+        if(header->flags & STATE_COMPRESSED)
+        {
+            decompressed = new State;
+            if(state_decompress(payload, header->payload_size, reinterpret_cast<uint8_t*>(decompressed), sizeof(State)))
+                state = decompressed;
+        }
+        else if(header->payload_size == sizeof(State))
+            state = reinterpret_cast<const State*>(payload); /* Straight from the mapped pages */
+    }
+
+    StateFile::~StateFile()
+    {
+        delete decompressed;
+        if(mapping)
+            munmap(mapping, mapping_size);
+    }
+}
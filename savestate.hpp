@@ -0,0 +1,64 @@
+#ifndef Z80_SAVESTATE_H
+#define Z80_SAVESTATE_H
+
+#include<cstdint>
+#include<cstddef>
+
+namespace Z80
+{
+    /* Save state file: a StateHeader followed by a State, either as is or
+     * compressed as a whole. Both are stored in host byte order so that an
+     * uncompressed file can be mapped and copied without being parsed. */
+    const uint16_t STATE_VERSION = 3; /* 1 had the halves of the register pairs swapped, 2 had no banks */
+    const uint16_t STATE_COMPRESSED = 0x1;
+    const uint16_t STATE_BYTE_ORDER = 0x1234; /* Read back as 0x3412 on a host of the other endianness */
+
+    struct StateHeader
+    {
+        char magic[4];           /* "Z80S" */
+        uint16_t version;
+        uint16_t byte_order;
+        uint16_t flags;
+        uint16_t reserved;
+        uint32_t payload_size;   /* Bytes following the header in the file */
+    };
+
+    struct State
+    {
+        uint16_t af, bc, de, hl;
+        uint16_t af_, bc_, de_, hl_;
+        uint16_t ix, iy, sp, pc;
+        uint8_t i, r;
+        uint8_t iff1, iff2;
+        uint8_t interrupt_mode;
+        uint8_t halted;
+        uint16_t reserved;
+        uint16_t banks[4];       /* Bank of the image shown in each 16 KB slot of the code space */
+        uint32_t cycles;
+        uint8_t ports[256];
+        uint8_t memory[65536];
+    };
+
+    bool write_state(const char* filename, const State& state, bool compress);
+
+    /* Maps a save state file, get() is null if it could not be read */
+    class StateFile
+    {
+        public:
+            StateFile(const char* filename);
+            ~StateFile();
+            const State* get() const { return state; }
+
+        private:
+            void* mapping = nullptr;
+            size_t mapping_size = 0;
+            State* decompressed = nullptr;
+            const State* state = nullptr;
+    };
+
+    /* LZ77 with byte aligned tokens, returns the size of the output */
+    unsigned int state_compress(const uint8_t* src, unsigned int size, uint8_t* dst);
+    bool state_decompress(const uint8_t* src, unsigned int size, uint8_t* dst, unsigned int dst_size);
+}
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef Z80_SPSC_H
+#define Z80_SPSC_H
+
+#include<atomic>
+
+namespace Z80
+{
+    /* Bounded lock-free queue for one producer thread and one consumer
+     * thread. Size is a power of two. Each side keeps a copy of the other
+     * side's index and only reloads it when the queue looks full or empty,
+     * so the cache line of the other side is rarely touched. */
+    template <class T, unsigned int Size>
+    class SPSCQueue
+    {
+        static_assert((Size & (Size - 1)) == 0, "Size must be a power of two");
+
+        public:
+            bool push(const T& item) /* False when full */
+            {
+                unsigned int position = tail.load(std::memory_order_relaxed);
+                if(position - head_seen == Size)
+                {
+                    head_seen = head.load(std::memory_order_acquire);
+                    if(position - head_seen == Size)
+                        return false;
+                }
+                items[position & (Size - 1)] = item;
+                tail.store(position + 1, std::memory_order_release);
+                return true;
+            }
+
+            bool pop(T& item) /* False when empty */
+            {
+                unsigned int position = head.load(std::memory_order_relaxed);
+                if(position == tail_seen)
+                {
+                    tail_seen = tail.load(std::memory_order_acquire);
+                    if(position == tail_seen)
+                        return false;
+                }
+                item = items[position & (Size - 1)];
+                head.store(position + 1, std::memory_order_release);
+                return true;
+            }
+
+        private:
+            alignas(64) std::atomic<unsigned int> head{0}; /* Consumer side */
+            unsigned int tail_seen = 0;
+            alignas(64) std::atomic<unsigned int> tail{0}; /* Producer side */
+            unsigned int head_seen = 0;
+            alignas(64) T items[Size];
+    };
+}
+
+#endif
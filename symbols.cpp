@@ -0,0 +1,172 @@
+#include<cstdint>
+#include<cstdio>
+#include<cctype>
+#include<cstring>
+#include<algorithm>
+#include<fstream>
+#include<sstream>
+
+#include "symbols.hpp"
+
+namespace Z80
+{
+    /* 0x1234, $1234, #1234, 1234h, or bare digits in the given base. A bank: prefix is dropped */
+    static bool parse_number(std::string token, bool hex, uint32_t& value)
+    {
+        size_t colon = token.rfind(':');
+        if(colon != std::string::npos && colon + 1 < token.size())
+            token = token.substr(colon + 1);
+
+        if(token.size() > 2 && token[0] == '0' && (token[1] == 'x' || token[1] == 'X'))
+            token = token.substr(2), hex = true;
+        else if(token.size() > 1 && (token[0] == '$' || token[0] == '#'))
+            token = token.substr(1), hex = true;
+        else if(token.size() > 1 && (token.back() == 'h' || token.back() == 'H') && isdigit(token[0]))
+            token.pop_back(), hex = true;
+
+        if(token.empty())
+            return false;
+        value = 0;
+        for(char c : token)
+        {
+            if(hex ? !isxdigit(c) : !isdigit(c))
+                return false;
+            value = value * (hex ? 16 : 10) + (isdigit(c) ? c - '0' : (tolower(c) - 'a' + 10));
+        }
+        return value <= 0xFFFF;
+    }
+
+    static bool is_identifier(const std::string& token)
+    {
+        if(token.empty() || !(isalpha(token[0]) || token[0] == '_' || token[0] == '.' || token[0] == '@'))
+            return false;
+        for(char c : token)
+            if(!(isalnum(c) || c == '_' || c == '.' || c == '@' || c == '$'))
+                return false;
+        return true;
+    }
+
+    bool Symbols::load(const char* filename)
+    {
+        std::ifstream file(filename);
+        std::string line;
+
+        if(!file.is_open())
+        {
+            printf("No such file: %s\n", filename);
+            return false;
+        }
+
+        size_t length = strlen(filename);
+        bool listing = length > 4 && strcasecmp(filename + length - 4, ".lst") == 0;
+        while(std::getline(file, line))
+            parse(line, listing);
+        index();
+        return true;
+    }
+
+    void Symbols::parse(const std::string& line, bool listing)
+    {
+        std::string text = line.substr(0, line.find(';'));
+        bool assignment = text.find('=') != std::string::npos; /* Not an = in a comment */
+        std::replace(text.begin(), text.end(), '=', ' ');
+        std::replace(text.begin(), text.end(), '\t', ' ');
+
+        std::vector<std::string> tokens;
+        std::istringstream words(text);
+        for(std::string word; words >> word;)
+            tokens.push_back(word);
+
+        uint32_t value;
+
+        if(listing)
+        {
+            /* Some listings start with a line number, which may have four digits too, so the
+             * address is the last field of four hex digits before the instruction bytes. The
+             * label ends with a colon. */
+            uint32_t address = 0;
+            bool found = false, bytes = false;
+            for(const std::string& token : tokens)
+            {
+                if(token.size() > 1 && token.back() == ':' && is_identifier(token.substr(0, token.size() - 1)))
+                {
+                    if(found)
+                        symbols.push_back({uint16_t(address), token.substr(0, token.size() - 1)});
+                    return;
+                }
+                if(!bytes && token.size() == 4 && parse_number(token, true, value))
+                {
+                    address = value;
+                    found = true;
+                }
+                else if(found && token.size() == 2 && isxdigit(token[0]) && isxdigit(token[1]))
+                    bytes = true;
+            }
+            return;
+        }
+
+        if(tokens.size() >= 3 && strcasecmp(tokens[1].c_str(), "equ") == 0)
+        {
+            tokens.erase(tokens.begin() + 1);
+            assignment = true;
+        }
+        if(tokens.size() < 2)
+            return;
+
+        std::string name = tokens[0];
+        if(name.size() > 1 && name.back() == ':')
+            name.pop_back();
+
+        if(assignment)
+        {
+            if(is_identifier(name) && parse_number(tokens[1], false, value))
+                symbols.push_back({uint16_t(value), name});
+        }
+        else if(is_identifier(tokens[1]) && parse_number(tokens[0], true, value)) /* Maps list addresses in hex */
+            symbols.push_back({uint16_t(value), tokens[1]});
+        else if(is_identifier(name) && parse_number(tokens[1], true, value))
+            symbols.push_back({uint16_t(value), name});
+    }
+
+    /* The first symbol read for an address is kept */
+    void Symbols::index()
+    {
+        std::stable_sort(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) { return a.address < b.address; });
+        symbols.erase(std::unique(symbols.begin(), symbols.end(), [](const Symbol& a, const Symbol& b) { return a.address == b.address; }), symbols.end());
+
+        table.assign(65536, 0);
+        for(size_t n = 0; n<symbols.size(); ++n)
+        {
+            unsigned int end = n + 1 < symbols.size() ? symbols[n+1].address : 65536;
+            std::fill(table.begin() + symbols[n].address, table.begin() + end, n + 1);
+        }
+    }
+
+    const char* Symbols::find(uint16_t address, uint16_t* offset) const
+    {
+        if(table.empty() || !table[address])
+            return nullptr;
+
+        const Symbol& symbol = symbols[table[address] - 1];
+        if(offset)
+            *offset = address - symbol.address;
+        return symbol.name.c_str();
+    }
+
+    std::string Symbols::describe(uint16_t address) const
+    {
+        uint16_t offset;
+        char text[8];
+        const char* name = find(address, &offset);
+
+        if(!name)
+        {
+            snprintf(text, sizeof(text), "%04x", address);
+            return text;
+        }
+        if(!offset)
+            return name;
+        snprintf(text, sizeof(text), "+%x", offset);
+        return name + std::string(text);
+    }
+}
@@ -0,0 +1,40 @@
+#ifndef Z80_SYMBOLS_H
+#define Z80_SYMBOLS_H
+
+#include<cstdint>
+#include<string>
+#include<vector>
+
+namespace Z80
+{
+    /* Labels of a program, read from the symbol files of Z80 assemblers:
+     * "name equ 1234h" or "name = $1234" lines (.sym), "1234 name" lines
+     * (.map, the address may have a bank: prefix) and listings where an
+     * address starts a line holding "name:" (.lst). Each symbol covers the
+     * addresses up to the next one, so a pc is found in the function
+     * holding it. Lookups go through a table of every address. */
+    class Symbols
+    {
+        public:
+            bool load(const char* filename); /* Adds the symbols of a file, several files can be loaded */
+
+            const char* find(uint16_t address, uint16_t* offset = nullptr) const; /* Null below the first symbol */
+            std::string describe(uint16_t address) const; /* "name+offset", or the address in hex */
+            size_t size() const { return symbols.size(); }
+
+        private:
+            struct Symbol
+            {
+                uint16_t address;
+                std::string name;
+            };
+
+            std::vector<Symbol> symbols;  /* By address, one per address */
+            std::vector<uint32_t> table;  /* Index + 1 of the symbol covering each address, 0 for none */
+
+            void parse(const std::string& line, bool listing);
+            void index();
+    };
+}
+
+#endif
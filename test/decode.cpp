@@ -0,0 +1,138 @@
+#include "../z80.hpp"
+#include "../opcodes.hpp"
+#include<cstdio>
+#include<cstring>
+#include<utility>
+
+/* Walks every opcode of every prefix and checks that what the opcode tables
+ * say of length, flow and target is what the interpreter does to pc */
+
+const uint16_t ADDRESS = 0x8000;
+const uint16_t RETURN = 0x5678; /* Left on the stack for returns */
+
+class Probe : public Z80::Z80Core<Probe>
+{
+    public:
+        uint8_t code[65536];
+
+        uint8_t fetch(int offset) { return code[uint16_t(pc + offset)]; }
+
+        /* Runs the instruction at ADDRESS with the given flags, returns pc */
+        uint16_t run_one(uint8_t flags)
+        {
+            A() = 0x00; F() = flags;
+            BC.p = 0x0001; DE.p = 0x4000; HL.p = 0x4100; /* Block instructions stop after one byte */
+            IX.p = 0x4200; IY.p = 0x4300;
+            sp = 0xF000;
+            memory[sp] = RETURN & 0xFF; memory[sp+1] = RETURN >> 8;
+            pc = ADDRESS;
+            pins[17] = false;
+            status = Z80::Status::Ok;
+            execute(fetch(0));
+            return pc;
+        }
+
+        uint16_t get(const char* name)
+        {
+            if(strstr(name, "ix"))
+                return IX.p;
+            if(strstr(name, "iy"))
+                return IY.p;
+            return HL.p;
+        }
+};
+
+static Probe probe;
+
+/* Length of the instruction at address, per the tables */
+static unsigned int length_at(uint16_t address)
+{
+    Z80::Instruction instruction;
+    return Z80::decode(probe.code, sizeof(probe.code), address, instruction) ? instruction.length : 0;
+}
+
+/* bytes are the prefixes and the opcode, followed in memory by 05 34 12 as
+ * displacement and operands. The DDCB and FDCB opcode comes after the displacement. */
+static bool check(const uint8_t* bytes, unsigned int count, unsigned int& checked)
+{
+    const uint8_t operands[] = {0x05, 0x34, 0x12};
+
+    memset(probe.code, 0x00, sizeof(probe.code)); /* nop after the instruction */
+    memcpy(probe.code + ADDRESS, bytes, count);
+    memcpy(probe.code + ADDRESS + count, operands, sizeof(operands));
+    if(count == 3)
+        std::swap(probe.code[ADDRESS + 2], probe.code[ADDRESS + 3]);
+
+    Z80::Instruction instruction;
+    if(!Z80::decode(probe.code, sizeof(probe.code), ADDRESS, instruction))
+    {
+        printf("%02X %02X %02X: not decoded\n", bytes[0], bytes[1], bytes[2]);
+        return false;
+    }
+
+    /* A prefix without effect runs with the following instruction, and so does ei */
+    uint16_t next = ADDRESS + instruction.length;
+    bool chained = (instruction.length == 1 && (bytes[0] == 0xDD || bytes[0] == 0xFD)) || strcmp(instruction.text, "ei") == 0;
+    if(chained)
+        next += length_at(next);
+
+    for(uint8_t flags : {0x00, 0xFF})
+    {
+        uint16_t pc = probe.run_one(flags);
+        if(probe.get_status() == Z80::Status::Unimplemented)
+        {
+            if(pc == ADDRESS || (chained && pc == ADDRESS + instruction.length))
+                return true; /* Left on the unknown instruction */
+            printf("%s: unimplemented but pc moved to %04X\n", instruction.text, pc);
+            return false;
+        }
+
+        bool agree = false;
+        switch(instruction.flow)
+        {
+            case Z80::Flow::Next:
+                agree = pc == next; break;
+            case Z80::Flow::Jump:
+            case Z80::Flow::Call:
+            case Z80::Flow::Restart:
+                agree = pc == instruction.target; break;
+            case Z80::Flow::Branch:
+            case Z80::Flow::CondCall:
+                agree = pc == next || pc == instruction.target; break;
+            case Z80::Flow::Return:
+                agree = pc == RETURN; break;
+            case Z80::Flow::CondReturn:
+                agree = pc == next || pc == RETURN; break;
+            case Z80::Flow::Indirect:
+                agree = pc == probe.get(instruction.text); break;
+            case Z80::Flow::Halt:
+                agree = pc == next - 1; break; /* Stays on the opcode until interrupted */
+        }
+        if(!agree)
+        {
+            printf("%s (length %u, target %04X): interpreter went to %04X\n", instruction.text, instruction.length, instruction.target, pc);
+            return false;
+        }
+    }
+    checked++;
+    return true;
+}
+
+int main()
+{
+    const uint8_t prefixes[][2] = {{}, {0xCB}, {0xED}, {0xDD}, {0xFD}, {0xDD, 0xCB}, {0xFD, 0xCB}};
+    const unsigned int counts[] = {0, 1, 1, 1, 1, 2, 2};
+    unsigned int failed = 0, checked = 0;
+
+    for(unsigned int p = 0; p<7; ++p)
+        for(unsigned int opcode = 0; opcode<256; ++opcode)
+        {
+            uint8_t bytes[3] = {prefixes[p][0], prefixes[p][1], 0};
+            bytes[counts[p]] = opcode;
+            if(!check(bytes, counts[p] + 1, checked))
+                failed++;
+        }
+
+    printf("%u encodings agree, %u disagree, %u are not implemented\n", checked, failed, 7*256 - checked - failed);
+    return failed ? 1 : 0;
+}
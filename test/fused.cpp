@@ -0,0 +1,84 @@
+#include "../z80.hpp"
+#include "../savestate.hpp"
+#include<cstdio>
+#include<cstring>
+#include<unistd.h>
+
+/* Runs a loop made of the fused pairs on variant::Accurate, which fuses
+ * them, and on variant::Profile, which runs them one by one and counts
+ * them, and checks that both are in the same state wherever they meet */
+
+static const uint8_t program[] = {
+    0x31, 0x00, 0xF0,                /* 0000 ld sp, 0f000h */
+    0x21, 0x00, 0x80,                /* 0003 ld hl, 8000h */
+    0x11, 0x00, 0x90,                /* 0006 ld de, 9000h */
+    0x06, 0x20,                      /* 0009 start: ld b, 20h */
+    0x7E, 0x23,                      /* 000B loop: ld a, (hl); inc hl */
+    0x12, 0x13,                      /* 000D ld (de), a; inc de */
+    0x1A, 0x13,                      /* 000F ld a, (de); inc de */
+    0x80,                            /* 0011 add a, b */
+    0x77,                            /* 0012 ld (hl), a */
+    0x05, 0x20, 0xF6,                /* 0013 dec b; jr nz, loop */
+    0x0C,                            /* 0016 inc c */
+    0xC3, 0x09, 0x00                 /* 0017 jp start */
+};
+
+/* The pairs execute() fuses, as previous << 8 | opcode */
+static const uint16_t fused[] = {0x7E23, 0x1213, 0x1A13, 0x0520};
+
+class Fused : public Z80::Z80Core<Fused> {};
+class Unfused : public Z80::Z80Core<Unfused, Z80::variant::Profile> {};
+
+static Fused fast;
+static Unfused slow;
+static uint32_t counts[65536];
+static Z80::State expected, actual;
+
+static uint64_t retired(const Z80::Metrics& metrics) { return metrics.instructions.get(); }
+
+int main()
+{
+    char filename[] = "/tmp/fusedXXXXXX";
+    int fd = mkstemp(filename);
+    if(fd < 0 || write(fd, program, sizeof(program)) != sizeof(program))
+        return 1;
+    close(fd);
+
+    bool loaded = fast.load(filename) && slow.load(filename);
+    unlink(filename);
+    if(!loaded)
+        return 1;
+    slow.set_pair_counts(counts);
+
+    /* A fused pair may run past the budget, the unfused core catches up
+     * one instruction at a time */
+    unsigned int seed = 1, meetings = 0;
+    while(fast.elapsed() < 1000000)
+    {
+        seed = seed * 1103515245 + 12345;
+        fast.run(1 + (seed >> 16) % 200);
+        while(retired(slow.get_metrics()) < retired(fast.get_metrics()))
+            slow.run(1);
+
+        fast.save_state(expected);
+        slow.save_state(actual);
+        if(retired(slow.get_metrics()) != retired(fast.get_metrics()) || memcmp(&expected, &actual, sizeof(expected)) != 0)
+        {
+            printf("States differ after %llu instructions: pc %04X and %04X, af %04X and %04X, hl %04X and %04X, r %02X and %02X, cycles %u and %u\n",
+                   (unsigned long long)retired(fast.get_metrics()), expected.pc, actual.pc, expected.af, actual.af,
+                   expected.hl, actual.hl, expected.r, actual.r, expected.cycles, actual.cycles);
+            return 1;
+        }
+        meetings++;
+    }
+
+    for(uint16_t pair : fused)
+        if(counts[pair] == 0)
+        {
+            printf("Pair %04X was never run\n", pair);
+            return 1;
+        }
+
+    printf("Fused and unfused runs agree at %u points over %llu T-states\n", meetings, (unsigned long long)fast.elapsed());
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+#include<cstring>
+#include<unistd.h>
+
+/* Runs a ROM on the interpreter and on its translation by tools/translate,
+ * and checks that registers, memory, ports, cycles and counters agree at
+ * every point both cores stop on. Built twice by test/build: with WRITE_ROM
+ * it only writes the ROM to translate. */
+
+static const uint8_t program[] = {
+    0xC3, 0x10, 0x00,                /* 0000 jp main */
+    0x00, 0x00, 0x00, 0x00, 0x00,
+    0xC9,                            /* 0008 ret */
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x31, 0x00, 0xF0,                /* 0010 main: ld sp, 0f000h */
+    0xFB,                            /* 0013 ei, runs the following inc a with it */
+    0x3C,                            /* 0014 inc a */
+    0x3C,                            /* 0015 inc a */
+    0xD3, 0x01,                      /* 0016 out (1), a */
+    0x06, 0x40,                      /* 0018 ld b, 40h */
+    0xC5,                            /* 001A loop: push bc */
+    0x21, 0x00, 0x80,                /* 001B ld hl, 8000h */
+    0x78,                            /* 001E ld a, b */
+    0x86,                            /* 001F add a, (hl) */
+    0x77,                            /* 0020 ld (hl), a */
+    0x23,                            /* 0021 inc hl */
+    0x22, 0x10, 0x80,                /* 0022 ld (8010h), hl */
+    0xDD, 0x21, 0x20, 0x80,          /* 0025 ld ix, 8020h */
+    0xDD, 0x77, 0x02,                /* 0029 ld (ix+2), a */
+    0xCB, 0x06,                      /* 002C rlc (hl) */
+    0xED, 0x5F,                      /* 002E ld a, r */
+    0x32, 0x30, 0x80,                /* 0030 ld (8030h), a */
+    0xCD, 0x4A, 0x00,                /* 0033 call sub */
+    0xCF,                            /* 0036 rst 08h */
+    0x21, 0x00, 0x80,                /* 0037 ld hl, 8000h */
+    0x11, 0x00, 0x81,                /* 003A ld de, 8100h */
+    0x01, 0x10, 0x00,                /* 003D ld bc, 0010h */
+    0xED, 0xB0,                      /* 0040 ldir */
+    0xC1,                            /* 0042 pop bc */
+    0xFB,                            /* 0043 ei, runs the djnz with it */
+    0x10, 0xD4,                      /* 0044 djnz loop */
+    0x21, 0x58, 0x00,                /* 0046 ld hl, end */
+    0xE9,                            /* 0049 jp (hl), not followed by the analyzer */
+    0x4F,                            /* 004A sub: ld c, a */
+    0xE6, 0x0F,                      /* 004B and 0fh */
+    0xC8,                            /* 004D ret z */
+    0x79,                            /* 004E ld a, c */
+    0xD6, 0x03,                      /* 004F sub 3 */
+    0x30, 0x01,                      /* 0051 jr nc, $+3 */
+    0x3C,                            /* 0053 inc a */
+    0x32, 0x31, 0x80,                /* 0054 ld (8031h), a */
+    0xC9,                            /* 0057 ret */
+    0xAF,                            /* 0058 end: xor a */
+    0x76                             /* 0059 halt */
+};
+
+#ifdef WRITE_ROM
+
+int main(int argc, char* argv[])
+{
+    FILE* file = argc > 1 ? fopen(argv[1], "wb") : nullptr;
+    if(!file || fwrite(program, sizeof(program), 1, file) != 1)
+        return 1;
+    fclose(file);
+    return 0;
+}
+
+#else
+
+#include "../z80.hpp"
+#include "../savestate.hpp"
+#include "lockstep.hpp"
+
+class Interpreted : public Z80::Z80Core<Interpreted> {};
+
+class Translated : public Lockstep<Translated>
+{
+    public:
+        bool is_translated() const { return this->translated; }
+};
+
+static Interpreted interpreted;
+static Translated translated;
+static Z80::State expected, actual;
+
+static uint64_t retired(const Z80::Metrics& metrics) { return metrics.instructions.get(); }
+
+/* Both cores stopped after the same instruction, everything has to match */
+static bool compare()
+{
+    interpreted.save_state(expected);
+    translated.save_state(actual);
+    if(memcmp(&expected, &actual, sizeof(expected)) != 0)
+    {
+        printf("States differ after %llu instructions: pc %04X and %04X, af %04X and %04X, r %02X and %02X, cycles %u and %u\n",
+               (unsigned long long)retired(interpreted.get_metrics()), expected.pc, actual.pc, expected.af, actual.af,
+               expected.r, actual.r, expected.cycles, actual.cycles);
+        return false;
+    }
+    if(interpreted.get_metrics().t_states.get() != translated.get_metrics().t_states.get())
+    {
+        printf("T-state counters differ after %llu instructions\n", (unsigned long long)retired(interpreted.get_metrics()));
+        return false;
+    }
+    return true;
+}
+
+int main()
+{
+    char filename[] = "/tmp/lockstepXXXXXX";
+    int fd = mkstemp(filename);
+    if(fd < 0 || write(fd, program, sizeof(program)) != sizeof(program))
+        return 1;
+    close(fd);
+
+    bool loaded = interpreted.load(filename) && translated.load(filename);
+    unlink(filename);
+    if(!loaded || !translated.is_translated())
+    {
+        printf("The translation was not used\n");
+        return 1;
+    }
+
+    /* The translation stops between blocks only, so the interpreter is
+     * stepped up to it and both are compared wherever they meet. They meet
+     * on instruction counts: ED instructions take no T-states here. */
+    unsigned int seed = 1, meetings = 0;
+    Z80::Status status = Z80::Status::Ok;
+    while(status != Z80::Status::Halted && translated.elapsed() < 1000000)
+    {
+        seed = seed * 1103515245 + 12345;
+        status = translated.run(1 + (seed >> 16) % 200);
+        while(retired(interpreted.get_metrics()) != retired(translated.get_metrics()))
+        {
+            if(retired(interpreted.get_metrics()) < retired(translated.get_metrics()))
+                interpreted.run(1);
+            else
+                status = translated.run(1);
+        }
+        if(!compare())
+            return 1;
+        meetings++;
+    }
+
+    if(status != Z80::Status::Halted || interpreted.get_status() != Z80::Status::Halted)
+    {
+        printf("The program did not reach its halt\n");
+        return 1;
+    }
+    printf("Both cores agree at %u points over %llu T-states\n", meetings, (unsigned long long)translated.elapsed());
+    return 0;
+}
+
+#endif
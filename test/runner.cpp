@@ -0,0 +1,88 @@
+#include "../z80.hpp"
+#include "../runner.hpp"
+#include<cstdio>
+#include<cstdlib>
+#include<unistd.h>
+
+/* Drives a Runner from this thread: pause, poke, snapshot, resume, and checks
+ * what the snapshots saw */
+
+static bool failed = false;
+
+static void expect(bool condition, const char* what)
+{
+    printf("%s: %s\n", condition ? "ok" : "FAILED", what);
+    failed |= !condition;
+}
+
+int main()
+{
+    /* loop: ld hl, 9001h; inc (hl); jr loop */
+    const uint8_t code[] = {0x21, 0x01, 0x90, 0x34, 0x18, 0xFA};
+    char filename[] = "/tmp/runnerXXXXXX";
+    int fd = mkstemp(filename);
+    if(fd < 0 || write(fd, code, sizeof(code)) != sizeof(code))
+        return 1;
+    close(fd);
+
+    static Z80::Z80 cpu;
+    static Z80::State before, after;
+    bool loaded = cpu.load(filename);
+    unlink(filename);
+    if(!loaded)
+        return 1;
+    cpu.set_bank_register(0x9100, 1);
+
+    Z80::Runner<Z80::Z80> runner(cpu);
+    runner.start();
+    runner.pause();
+    runner.wait();
+
+    uint64_t frames = cpu.get_metrics().frames.get();
+    usleep(50000);
+    expect(cpu.get_metrics().frames.get() == frames, "no frame runs while paused");
+
+    runner.poke(0x9000, 0x42);
+    runner.poke(0x9100, 2);
+    runner.snapshot(before);
+    runner.wait();
+    expect(before.memory[0x9000] == 0x42, "poke is in the snapshot");
+    expect(before.banks[1] == 2, "poke to a bank register switches the bank");
+
+    runner.resume();
+    usleep(100000);
+    runner.pause();
+    runner.snapshot(after);
+    runner.wait();
+    expect(cpu.get_metrics().frames.get() > frames, "frames run once resumed");
+    expect(after.memory[0x9000] == 0x42, "poke survives running");
+    runner.stop();
+
+    expect(cpu.is_dirty(0x9000), "poke marks its page written");
+
+    /* loop: ld a, 1; an unknown ED opcode; jr loop */
+    const uint8_t unknown[] = {0x3E, 0x01, 0xED, 0x00, 0x18, 0xFA};
+    char unknown_filename[] = "/tmp/runnerXXXXXX";
+    fd = mkstemp(unknown_filename);
+    if(fd < 0 || write(fd, unknown, sizeof(unknown)) != sizeof(unknown))
+        return 1;
+    close(fd);
+
+    static Z80::Z80 bad;
+    loaded = bad.load(unknown_filename);
+    unlink(unknown_filename);
+    if(!loaded)
+        return 1;
+
+    Z80::Runner<Z80::Z80> stopping(bad);
+    stopping.start();
+    for(unsigned int n = 0; n<100 && stopping.stopped() == Z80::Status::Ok; ++n)
+        usleep(10000);
+    frames = bad.get_metrics().frames.get();
+    usleep(50000);
+    expect(stopping.stopped() == Z80::Status::Unimplemented, "an unknown opcode stops the runner");
+    expect(bad.get_metrics().frames.get() == frames, "no frame runs once stopped");
+    stopping.stop();
+
+    return failed ? 1 : 0;
+}
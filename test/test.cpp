@@ -1,20 +1,31 @@
 #include "../z80.hpp"
+#include "../gdbstub.hpp"
 #include<iostream>
+#include<cstdlib>
 
 int main(int argc, char* argv[])
 {
     if(argc < 2)
     {
-        std::cout << "Usage: " << argv[0] << " [filename]\n";
+        std::cout << "Usage: " << argv[0] << " [filename] [gdb port]\n";
         return -1;
     }
 
     Z80::Z80 cpu;
+    Z80::GDBStub gdb(cpu);
 
     cpu.load(argv[1]);
+    if(argc > 2)
+        gdb.listen(atoi(argv[2]));
+
     while(true)
     {
-        cpu.step();
+        gdb.poll();
+        if(cpu.step() == Z80::Status::Unimplemented && !gdb.attached()) /* A debugger is told by poll() */
+        {
+            std::cout << "Unimplemented instruction\n";
+            return 1;
+        }
     }
 
     return 0;
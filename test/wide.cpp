@@ -0,0 +1,173 @@
+#include "../z80.hpp"
+#include "../savestate.hpp"
+#include "../wide.hpp"
+#include<cstdio>
+#include<cstring>
+#include<unistd.h>
+
+/* Runs lanes of a Wide engine on inputs which send them down different
+ * branches and ROM banks, and checks every lane against a scalar core
+ * after each run() */
+
+const unsigned int LANES = 40; /* Fills SSE2 and AVX2 registers and leaves lanes over */
+
+/* Read from port 0, odd and even values select different banks */
+static uint8_t input(unsigned int lane) { return lane * 0x9D + 0x11; }
+
+static const uint8_t program[] = {
+    0xDB, 0x00,                      /* 0000 start: in a, (0) */
+    0x47,                            /* 0002 ld b, a */
+    0xE6, 0x01,                      /* 0003 and 1 */
+    0x3C,                            /* 0005 inc a */
+    0xD3, 0x01,                      /* 0006 out (1), a, maps bank 1 or 2 in slot 1 */
+    0x78,                            /* 0008 ld a, b */
+    0x0E, 0x10,                      /* 0009 ld c, 10h */
+    0x81,                            /* 000B loop: add a, c */
+    0x30, 0x01,                      /* 000C jr nc, skip */
+    0x14,                            /* 000E inc d */
+    0x0D,                            /* 000F skip: dec c */
+    0xC2, 0x0B, 0x00,                /* 0010 jp nz, loop */
+    0x31, 0x00, 0xF0,                /* 0013 ld sp, 0f000h */
+    0xCD, 0x00, 0x40,                /* 0016 call 4000h, the same pc in both banks */
+    0x32, 0x00, 0x80,                /* 0019 ld (8000h), a */
+    0x5F,                            /* 001C ld e, a */
+    0xFE, 0x40,                      /* 001D cp 40h */
+    0x38, 0x08,                      /* 001F jr c, done */
+    0x06, 0x00,                      /* 0021 ld b, 0 */
+    0xAB,                            /* 0023 more: xor e */
+    0x10, 0xFD,                      /* 0024 djnz more */
+    0x32, 0x01, 0x80,                /* 0026 ld (8001h), a */
+    0x76,                            /* 0029 done: halt */
+    0xC3, 0x00, 0x00                 /* 002A jp start */
+};
+
+static const uint8_t bank1[] = {
+    0x78,                            /* 4000 ld a, b */
+    0xD6, 0x03,                      /* 4001 sub 3 */
+    0x6F,                            /* 4003 ld l, a */
+    0xC9                             /* 4004 ret */
+};
+
+static const uint8_t bank2[] = {
+    0x78,                            /* 4000 ld a, b */
+    0xEE, 0x55,                      /* 4001 xor 55h */
+    0x67,                            /* 4003 ld h, a */
+    0x3C,                            /* 4004 inc a */
+    0xC9                             /* 4005 ret */
+};
+
+class Scalar : public Z80::Z80Core<Scalar> {};
+
+static Z80::Wide<LANES> wide;
+static Scalar scalars[LANES];
+static Z80::State expected, actual;
+
+static bool compare(unsigned int lane, Z80::Status status)
+{
+    Z80::Status wide_status = wide.get_status(lane);
+    if(wide_status != (status == Z80::Status::BudgetExhausted ? Z80::Status::Ok : status))
+    {
+        printf("Lane %u: status %d, the scalar core returned %d\n", lane, int(wide_status), int(status));
+        return false;
+    }
+
+    scalars[lane].save_state(expected);
+    wide.get_lane(lane).save_state(actual);
+    if(memcmp(&expected, &actual, sizeof(expected)) != 0)
+    {
+        printf("Lane %u differs: pc %04X and %04X, af %04X and %04X, hl %04X and %04X, r %02X and %02X, cycles %u and %u\n",
+               lane, expected.pc, actual.pc, expected.af, actual.af, expected.hl, actual.hl,
+               expected.r, actual.r, expected.cycles, actual.cycles);
+        return false;
+    }
+    return true;
+}
+
+/* Runs until every lane halted, returns the number of calls to run() or 0 on a difference */
+static unsigned int run_to_halt(unsigned int& seed)
+{
+    Z80::Status status[LANES];
+    for(unsigned int n = 0; n<LANES; ++n)
+        status[n] = Z80::Status::Ok;
+
+    unsigned int runs = 0, halted = 0;
+    while(halted < LANES && runs < 100000)
+    {
+        seed = seed * 1103515245 + 12345;
+        unsigned int budget = 1 + (seed >> 16) % 200;
+
+        wide.run(budget);
+        runs++;
+        halted = 0;
+        for(unsigned int n = 0; n<LANES; ++n)
+        {
+            if(status[n] != Z80::Status::Halted)
+                status[n] = scalars[n].run(budget);
+            if(!compare(n, status[n]))
+                return 0;
+            halted += status[n] == Z80::Status::Halted;
+        }
+    }
+    return halted == LANES ? runs : 0;
+}
+
+int main()
+{
+    static uint8_t image[3*0x4000];
+    memcpy(image, program, sizeof(program));
+    memcpy(image + 0x4000, bank1, sizeof(bank1));
+    memcpy(image + 0x8000, bank2, sizeof(bank2));
+
+    char filename[] = "/tmp/wideXXXXXX";
+    int fd = mkstemp(filename);
+    if(fd < 0 || write(fd, image, sizeof(image)) != sizeof(image))
+        return 1;
+    close(fd);
+
+    bool loaded = wide.load(filename);
+    for(unsigned int n = 0; n<LANES; ++n)
+        loaded &= scalars[n].load(filename);
+    unlink(filename);
+    if(!loaded)
+        return 1;
+
+    for(unsigned int n = 0; n<LANES; ++n)
+    {
+        scalars[n].set_bank_port(1, 1);
+        scalars[n].set_port(0, input(n));
+        wide.get_lane(n).set_bank_port(1, 1);
+        wide.get_lane(n).set_port(0, input(n));
+        wide.set_lane(n);
+    }
+
+    /* Halted lanes stay so until interrupted, then start over */
+    unsigned int seed = 1, first = run_to_halt(seed);
+    if(first == 0)
+        return 1;
+    for(unsigned int n = 0; n<LANES; ++n)
+    {
+        wide.interrupt(n);
+        scalars[n].interrupt();
+    }
+    unsigned int second = run_to_halt(seed);
+    if(second == 0)
+        return 1;
+
+    /* The inputs have to have taken the lanes apart for the test to mean anything */
+    unsigned int diverged = 0, bank2_lanes = 0;
+    wide.get_lane(0).save_state(expected);
+    for(unsigned int n = 0; n<LANES; ++n)
+    {
+        wide.get_lane(n).save_state(actual);
+        diverged += actual.cycles != expected.cycles;
+        bank2_lanes += actual.banks[1] == 2;
+    }
+    if(diverged == 0 || bank2_lanes == 0 || bank2_lanes == LANES)
+    {
+        printf("The lanes did not diverge\n");
+        return 1;
+    }
+
+    printf("%u lanes agree with the scalar core over %u and %u runs\n", LANES, first, second);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include<cstdint>
+#include<cstdio>
+#include<cstdlib>
+#include<algorithm>
+#include<vector>
+
+#include "../z80.hpp"
+#include "../opcodes.hpp"
+
+/* Runs a ROM with variant::Profile and prints the opcode pairs it executed
+ * most, the candidates for the superinstructions of execute(). Prefixed
+ * instructions count by their prefix. A halted CPU is interrupted, as the
+ * frame interrupt of a host would do. */
+
+class Profiled : public Z80::Z80Core<Profiled, Z80::variant::Profile> {};
+
+static Profiled cpu;
+static uint32_t counts[65536];
+
+int main(int argc, char* argv[])
+{
+    if(argc < 2)
+    {
+        printf("Usage: %s [rom] [T-states, 100000000 by default] [pairs, 20 by default]\n", argv[0]);
+        return -1;
+    }
+    uint64_t t_states = argc > 2 ? strtoull(argv[2], nullptr, 0) : 100000000;
+    t_states = std::min<uint64_t>(t_states, 0xF0000000); /* The cycle counter of run() is 32 bits wide */
+    unsigned int shown = argc > 3 ? atoi(argv[3]) : 20;
+
+    if(!cpu.load(argv[1]))
+        return -1;
+    cpu.set_pair_counts(counts);
+
+    while(cpu.elapsed() < t_states)
+    {
+        Z80::Status status = cpu.run(std::min<uint64_t>(t_states - cpu.elapsed(), 1000000));
+        if(status == Z80::Status::Halted)
+            cpu.interrupt();
+        else if(status == Z80::Status::Unimplemented)
+        {
+            printf("Stopped on an unimplemented instruction after %llu T-states\n", (unsigned long long)cpu.elapsed());
+            break;
+        }
+    }
+
+    uint64_t total = 0;
+    std::vector<uint32_t> pairs;
+    for(uint32_t pair = 0; pair<65536; ++pair)
+    {
+        total += counts[pair];
+        if(counts[pair])
+            pairs.push_back(pair);
+    }
+    std::sort(pairs.begin(), pairs.end(), [](uint32_t x, uint32_t y) { return counts[x] > counts[y]; });
+
+    printf("%llu instructions\n", (unsigned long long)total);
+    for(unsigned int n = 0; n<shown && n<pairs.size(); ++n)
+    {
+        uint8_t first = pairs[n] >> 8, second = pairs[n] & 0xFF;
+        printf("%10u %5.2f%%  %02X %02X  %s; %s\n", counts[pairs[n]], 100.0 * counts[pairs[n]] / total,
+               first, second, Z80::main_opcodes[first].mnemonic, Z80::main_opcodes[second].mnemonic);
+    }
+    return 0;
+}
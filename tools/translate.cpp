@@ -0,0 +1,273 @@
+#include<cstdint>
+#include<cstdio>
+#include<cctype>
+#include<string>
+#include<vector>
+#include<fstream>
+#include<iterator>
+
+#include "../analyzer.hpp"
+
+/* Translates a ROM into a C++ header. Every basic block found by the analyzer
+ * becomes a member function calling the same helpers as z80.tpp; the
+ * instructions without a translation are run by the interpreter in place, and
+ * addresses which do not start a block are left to it entirely. */
+
+static const char* const registers[] = {"this->B()", "this->C()", "this->D()", "this->E()", "this->H()", "this->L()", nullptr, "this->A()"};
+static const char* const pairs[] = {"this->BC.p", "this->DE.p", "this->HL.p", "this->sp"};
+static const char* const stack_pairs[] = {"this->BC.p", "this->DE.p", "this->HL.p", "this->AF.p"};
+static const char* const conditions[] = {"!this->get_flag(6)", "this->get_flag(6)", "!this->get_flag(0)", "this->get_flag(0)",
+                                         "!this->get_flag(2)", "this->get_flag(2)", "!this->get_flag(7)", "this->get_flag(7)"};
+
+static std::string hex(unsigned int value, int digits)
+{
+    char s[8];
+    snprintf(s, sizeof(s), "0x%0*X", digits, value);
+    return s;
+}
+
+static std::string source(unsigned int index) /* r field as a value */
+{
+    return index == 6 ? "this->derived().read_memory(this->HL.p)" : registers[index];
+}
+
+static std::string destination(unsigned int index) /* r field as a reference */
+{
+    return index == 6 ? "this->derived().get_memory(this->HL.p)" : registers[index];
+}
+
+/* Code of one instruction, empty when the interpreter has to run it. The
+ * cycle counts and helpers are those of the matching case in execute(). */
+static std::string translate(const uint8_t* rom, const Z80::Instruction& instruction, bool& native)
+{
+    uint8_t opcode = rom[instruction.address];
+    unsigned int y = opcode >> 3 & 0x7, z = opcode & 0x7;
+    std::string next = hex((instruction.address + instruction.length) & 0xFFFF, 4);
+    std::string target = hex(instruction.target, 4);
+    std::string byte = instruction.length > 1 ? hex(rom[instruction.address + 1], 2) : "";
+    std::string word = instruction.length > 2 ? hex(rom[instruction.address + 1] | rom[instruction.address + 2] << 8, 4) : "";
+    std::string taken = "this->pc = " + target + "; this->cover();";
+
+    native = true;
+    if(opcode >= 0x40 && opcode < 0x80 && opcode != 0x76)
+        return "this->cycles += " + std::string(y == 6 || z == 6 ? "7" : "4") + "; this->ld(" + destination(y) + ", " + source(z) + ");";
+    if(opcode >= 0x80 && opcode < 0xC0)
+        return "this->cycles += " + std::string(z == 6 ? "7" : "4") + "; this->alu(" + std::to_string(y) + ", " + source(z) + ");";
+
+    switch(opcode)
+    {
+        case 0x00:
+            return "this->cycles += 4;";
+        case 0x01: case 0x11: case 0x21: case 0x31:
+            return "this->cycles += 10; this->ld(" + std::string(pairs[opcode >> 4]) + ", " + word + ");";
+        case 0x02: case 0x12: /* ld (bc), a and ld (de), a */
+            return "this->cycles += 7; this->ld(this->derived().get_memory(" + std::string(pairs[opcode >> 4]) + "), this->A());";
+        case 0x0A: case 0x1A:
+            return "this->cycles += 7; this->ld(this->A(), this->derived().read_memory(" + std::string(pairs[opcode >> 4]) + "));";
+        case 0x03: case 0x13: case 0x23: case 0x33:
+            return "this->cycles += 6; this->inc(" + std::string(pairs[opcode >> 4]) + ");";
+        case 0x0B: case 0x1B: case 0x2B: case 0x3B:
+            return "this->cycles += 6; this->dec(" + std::string(pairs[opcode >> 4]) + ");";
+        case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x34: case 0x3C:
+            return "this->cycles += " + std::string(y == 6 ? "11" : "4") + "; this->inc(" + destination(y) + ");";
+        case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x35: case 0x3D:
+            return "this->cycles += " + std::string(y == 6 ? "11" : "4") + "; this->dec(" + destination(y) + ");";
+        case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x36: case 0x3E:
+            return "this->cycles += " + std::string(y == 6 ? "10" : "7") + "; this->ld(" + destination(y) + ", " + byte + ");";
+        case 0xC1: case 0xD1: case 0xE1: case 0xF1:
+            return "this->cycles += 10; this->pop(" + std::string(stack_pairs[opcode >> 4 & 0x3]) + ");";
+        case 0xC5: case 0xD5: case 0xE5: case 0xF5:
+            return "this->cycles += 11; this->push(" + std::string(stack_pairs[opcode >> 4 & 0x3]) + ");";
+
+        case 0xC6: return "this->cycles += 7; this->add(this->A(), " + byte + ");";
+        case 0xCE: return "this->cycles += 7; this->add(this->A(), " + byte + " + this->get_flag(0));";
+        case 0xD6: return "this->cycles += 7; this->sub(" + byte + ");";
+        case 0xDE: return "this->cycles += 7; this->sub(" + byte + " + this->get_flag(0));";
+        case 0xE6: return "this->cycles += 7; this->bitwise_and(" + byte + ");";
+        case 0xEE: return "this->cycles += 7; this->bitwise_xor(" + byte + ");";
+        case 0xF6: return "this->cycles += 7; this->bitwise_or(" + byte + ");";
+        case 0xFE: return "this->cycles += 7; this->cp(" + byte + ");";
+
+        case 0x10: /* djnz */
+            return "this->pc = " + hex(instruction.address, 4) + "; this->djnz(" + std::to_string(static_cast<int8_t>(rom[instruction.address + 1])) + ");";
+        case 0x18: /* jr */
+            return "this->cycles += 12; " + taken;
+        case 0x20: case 0x28: case 0x30: case 0x38:
+            return "if(" + std::string(conditions[y - 4]) + ") {this->cycles += 12; " + taken + "}\n"
+                   "    else {this->cycles += 7; this->pc = " + next + ";}";
+        case 0xC3: /* jp */
+            return "this->cycles += 10; " + taken;
+        case 0xCD: /* call */
+            return "this->cycles += 17; this->push(" + next + "); " + taken;
+        case 0xC9: /* ret */
+            return "this->cycles += 10; this->pop(this->pc); this->cover();";
+    }
+
+    switch(opcode & 0xC7)
+    {
+        case 0xC0: /* ret cc */
+            return "if(" + std::string(conditions[y]) + ") {this->cycles += 11; this->pop(this->pc); this->cover();}\n"
+                   "    else {this->cycles += 5; this->pc = " + next + ";}";
+        case 0xC2: /* jp cc */
+            return "this->cycles += 10;\n"
+                   "    if(" + std::string(conditions[y]) + ") {" + taken + "}\n"
+                   "    else this->pc = " + next + ";";
+        case 0xC4: /* call cc */
+            return "if(" + std::string(conditions[y]) + ") {this->cycles += 17; this->push(" + next + "); " + taken + "}\n"
+                   "    else {this->cycles += 10; this->pc = " + next + ";}";
+        case 0xC7: /* rst */
+            return "this->cycles += 11; this->push(" + next + "); " + taken;
+    }
+
+    native = false;
+    return "";
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3)
+    {
+        printf("Usage: %s [rom] [class name] [output]\n", argv[0]);
+        return -1;
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if(!file.is_open())
+    {
+        printf("No such file: %s\n", argv[1]);
+        return -1;
+    }
+    std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if(rom.size() > 0x10000)
+        rom.resize(0x10000);
+
+    FILE* out = argc > 3 ? fopen(argv[3], "w") : stdout;
+    if(!out)
+    {
+        printf("Cannot write to: %s\n", argv[3]);
+        return -1;
+    }
+
+    Z80::Analyzer analyzer(rom.data(), rom.size());
+    analyzer.analyze();
+
+    /* Blocks start on labels and after every instruction which does not fall through */
+    std::vector<uint16_t> blocks;
+    bool after_jump = true;
+    for(unsigned int address = 0; address < rom.size(); ++address)
+    {
+        if(analyzer.get_kind(address) == Z80::Analyzer::Operand)
+            continue;
+        if(analyzer.get_kind(address) == Z80::Analyzer::Data)
+        {
+            after_jump = true;
+            continue;
+        }
+        if(after_jump || analyzer.is_label(address))
+            blocks.push_back(address);
+        after_jump = analyzer.get_instruction(address)->flow != Z80::Flow::Next;
+    }
+
+    uint32_t hash = 2166136261u; /* FNV-1a */
+    for(uint8_t byte : rom)
+        hash = (hash ^ byte) * 16777619u;
+
+    std::string name = argv[2];
+    std::string guard;
+    for(char c : name)
+        guard += toupper(c);
+
+    fprintf(out, "/* Translated from %s by tools/translate, do not edit */\n", argv[1]);
+    fprintf(out, "#ifndef %s_H\n#define %s_H\n\n#include \"z80.hpp\"\n\n", guard.c_str(), guard.c_str());
+    fprintf(out, "template <class Derived, class Variant = Z80::variant::Accurate>\n");
+    fprintf(out, "class %s : public Z80::Z80Core<Derived, Variant>\n{\n", name.c_str());
+    fprintf(out, "    public:\n");
+    fprintf(out, "        bool load(const char* filename); /* The translation is only used for the same ROM */\n");
+    fprintf(out, "        Z80::Status run(unsigned int budget);\n\n");
+    fprintf(out, "    protected:\n");
+    fprintf(out, "        static constexpr unsigned int rom_length = %zu;\n", rom.size());
+    fprintf(out, "        static constexpr uint32_t rom_hash = 0x%08X;\n", hash);
+    fprintf(out, "        bool translated = false;\n\n");
+    fprintf(out, "        void retire(unsigned int count) /* Bookkeeping of the instructions run natively */\n        {\n");
+    fprintf(out, "            this->m1 += count;\n");
+    fprintf(out, "            if constexpr(Variant::metrics)\n                this->metrics.instructions.add(count);\n");
+    fprintf(out, "        }\n\n");
+    for(uint16_t block : blocks)
+        fprintf(out, "        void block_%04X();\n", block);
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "template <class Derived, class Variant>\n");
+    fprintf(out, "bool %s<Derived, Variant>::load(const char* filename)\n{\n", name.c_str());
+    fprintf(out, "    uint32_t hash = 2166136261u;\n\n");
+    fprintf(out, "    if(!Z80::Z80Core<Derived, Variant>::load(filename))\n        return false;\n");
+    fprintf(out, "    for(unsigned int n = 0; n<this->rom_size; ++n)\n        hash = (hash ^ this->rom[n]) * 16777619u;\n");
+    fprintf(out, "    translated = this->rom_size == rom_length && hash == rom_hash;\n");
+    fprintf(out, "    return true;\n}\n\n");
+
+    /* Breakpoints, replays and contended fetches need the interpreter's instruction boundaries, switched banks its fetches */
+    fprintf(out, "template <class Derived, class Variant>\n");
+    fprintf(out, "Z80::Status %s<Derived, Variant>::run(unsigned int budget)\n{\n", name.c_str());
+    fprintf(out, "    unsigned int start = this->cycles;\n\n");
+    fprintf(out, "    if(!translated || this->banked || this->breakpoint_count || this->journal || (Variant::contention && this->contention_length))\n");
+    fprintf(out, "        return Z80::Z80Core<Derived, Variant>::run(budget);\n\n");
+    fprintf(out, "    this->status = Z80::Status::Ok;\n");
+    fprintf(out, "    while(this->status == Z80::Status::Ok && this->cycles - start < budget)\n    {\n");
+    fprintf(out, "        if(this->profiler && this->profiler->due())\n            this->sample();\n");
+    fprintf(out, "        switch(this->pc)\n        {\n");
+    for(uint16_t block : blocks)
+        fprintf(out, "            case 0x%04X: block_%04X(); break;\n", block, block);
+    fprintf(out, "            default: this->derived().execute(this->derived().fetch(0)); break;\n");
+    fprintf(out, "        }\n    }\n\n");
+    fprintf(out, "    this->metrics.t_states.add(this->cycles - start);\n");
+    fprintf(out, "    return this->status == Z80::Status::Ok ? Z80::Status::BudgetExhausted : this->status;\n}\n");
+
+    for(size_t n = 0; n<blocks.size(); ++n)
+    {
+        unsigned int end = n + 1 < blocks.size() ? blocks[n+1] : rom.size();
+        unsigned int address = blocks[n];
+        unsigned int native = 0;
+        std::string body;
+
+        while(address < end && analyzer.get_kind(address) == Z80::Analyzer::Code)
+        {
+            const Z80::Instruction& instruction = *analyzer.get_instruction(address);
+            bool translated;
+            std::string code = translate(rom.data(), instruction, translated);
+
+            body += "    /* " + std::string(instruction.text) + " */\n";
+            if(translated)
+            {
+                body += "    " + code + "\n";
+                native++;
+            }
+            else
+            {
+                /* The interpreter may read R, and the block may be left after it */
+                if(native)
+                    body += "    this->retire(" + std::to_string(native) + ");\n";
+                native = 0;
+                body += "    this->pc = " + hex(address, 4) + "; this->derived().execute(" + hex(rom[address], 2) + ");\n";
+                /* ei runs the following instruction as well, so pc is looked at rather than assumed */
+                if(instruction.flow == Z80::Flow::Next)
+                    body += "    if(this->status != Z80::Status::Ok || this->pc != " + hex((address + instruction.length) & 0xFFFF, 4) + ") return;\n";
+            }
+
+            address += instruction.length;
+            if(instruction.flow != Z80::Flow::Next)
+                break;
+            if(address >= end || analyzer.get_kind(address) != Z80::Analyzer::Code)
+                body += "    this->pc = " + hex(address & 0xFFFF, 4) + ";\n";
+        }
+
+        fprintf(out, "\ntemplate <class Derived, class Variant>\n");
+        fprintf(out, "void %s<Derived, Variant>::block_%04X()\n{\n", name.c_str(), blocks[n]);
+        if(native)
+            body += "    this->retire(" + std::to_string(native) + ");\n";
+        fprintf(out, "%s}\n", body.c_str());
+    }
+
+    fprintf(out, "\n#endif\n");
+    if(out != stdout)
+        fclose(out);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef Z80_VARIANT_H
+#define Z80_VARIANT_H
+
+namespace Z80
+{
+    /* CPU variants, given as template argument to Z80Core.
+     * Every member is a compile-time constant so that disabled features
+     * leave no code in the interpreter. */
+    namespace variant
+    {
+        /* Behaves like a real NMOS Z80 */
+        struct Accurate
+        {
+            static constexpr bool undocumented_flags = true; /* F3 and F5 copy bits of the result */
+            static constexpr bool undocumented_opcodes = true; /* sll, IXH/IXL/IYH/IYL and DDCB copies to registers */
+            static constexpr bool cmos = false;              /* out (c), 0 outputs 0xFF on CMOS parts */
+            static constexpr bool contention = true;         /* Wait states on contended memory pages */
+            static constexpr bool superinstructions = true;  /* Frequent opcode pairs run as one handler */
+            static constexpr bool pair_counts = false;       /* Counts executed opcode pairs */
+            static constexpr bool coverage = false;          /* Records control flow edges in a bitmap */
+            static constexpr bool metrics = true;            /* Counts retired instructions, other metrics are always kept */
+#ifdef DEBUG
+            static constexpr bool trace = true;              /* Prints PC and opcode of every instruction */
+#else
+            static constexpr bool trace = false;
+#endif
+        };
+
+        /* CMOS parts only differ by out (c), 0 */
+        struct CMOS : Accurate
+        {
+            static constexpr bool cmos = true;
+        };
+
+        /* Leaves out everything a program should not depend on */
+        struct Fast
+        {
+            static constexpr bool undocumented_flags = false;
+            static constexpr bool undocumented_opcodes = false;
+            static constexpr bool cmos = false;
+            static constexpr bool contention = false;
+            static constexpr bool superinstructions = true;
+            static constexpr bool pair_counts = false;
+            static constexpr bool coverage = false;
+            static constexpr bool metrics = false;
+            static constexpr bool trace = false;
+        };
+
+        /* Collects the opcode pairs the superinstructions are chosen from, see tools/pairs */
+        struct Profile : Accurate
+        {
+            static constexpr bool superinstructions = false;
+            static constexpr bool pair_counts = true;
+        };
+
+        /* Edge coverage for fuzzers, in the layout of an AFL shared memory map */
+        struct Coverage : Accurate
+        {
+            static constexpr bool coverage = true;
+            static constexpr bool trace = false;
+        };
+    }
+}
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef Z80_WIDE_H
+#define Z80_WIDE_H
+
+#include<cstdint>
+
+#include "z80.hpp"
+
+namespace Z80
+{
+    /* N CPUs running the same ROM in lockstep, for fuzzing and parameter sweeps.
+     * The main registers are stored as one array per register. Lanes sitting
+     * on the same pc execute the instruction together when it has a lane-wise
+     * kernel; everything else is run lane by lane on a scalar core. Register
+     * loads, jumps and the cycle and pc updates are written with AVX2 or SSE2
+     * intrinsics, whichever the compiler targets, and go through as many lanes
+     * at once as a vector register holds. The lanes left over, the ALU, inc
+     * and dec table lookups and other hosts use plain loops. Each lane
+     * keeps its own memory and ports. Lanes grouped together must also map the
+     * same ROM banks, the group fetches through the first of them.
+     * Kernels keep R and the instruction count of each lane; contention, pair
+     * counts, the T-state counter and the profiler are not looked at, and edge
+     * coverage is not available. */
+    template <unsigned int N, class Variant = variant::Accurate>
+    class Wide
+    {
+        static_assert(!Variant::coverage, "Kernels do not report the edges they take");
+
+        public:
+            /* Scalar core of a lane, used when no kernel exists or lanes diverge */
+            class Lane : public Z80Core<Lane, Variant>
+            {
+                public:
+                    void load_from(Wide& w, unsigned int n);
+                    void store_to(Wide& w, unsigned int n);
+                    void share_rom(const Lane& owner);
+                    void step_one() { this->status = Status::Ok; this->execute(this->fetch(0)); }
+                    uint8_t fetch_at(uint16_t address) { return this->rom_byte(address); }
+                    bool maps_like(const Lane& other) const;
+                    void retire(); /* Bookkeeping of an instruction run by a kernel */
+                    uint8_t* memory_base() { return this->memory; }
+                    uint8_t* ports_base() { return this->ports; }
+                    void alu(uint8_t opcode, uint8_t a, uint8_t operand, uint8_t flags, uint8_t& result, uint8_t& new_flags);
+            };
+
+            Wide();
+
+            bool load(const char* filename); /* Loads the ROM shared by all lanes */
+            void run(unsigned int budget);   /* Runs every lane for about budget cycles */
+            void interrupt(unsigned int lane); /* Wakes a Halted lane up */
+
+            uint8_t* get_memory(unsigned int lane);
+            uint8_t* get_ports(unsigned int lane);
+            Status get_status(unsigned int lane) const { return status[lane]; } /* Ok, Halted or Unimplemented */
+            Lane& get_lane(unsigned int lane); /* Scalar view, registers up to date */
+            void set_lane(unsigned int lane);  /* Takes back registers changed through get_lane() */
+
+        private:
+            /* Results of the 8 bit operations, filled by running the scalar core */
+            struct Tables
+            {
+                uint8_t result[8][256][256]; /* add, adc, sub, sbc, and, xor, or, cp by (a, operand) */
+                uint8_t flags[8][256][256];
+                uint8_t kept[8];             /* Flag bits left untouched by the operation */
+                uint8_t inc_result[256], inc_flags[256], inc_kept;
+                uint8_t dec_result[256], dec_flags[256], dec_kept;
+            };
+            static const Tables& tables();
+
+            alignas(32) uint8_t a[N], f[N], b[N], c[N], d[N], e[N], h[N], l[N];
+            alignas(32) uint16_t pc[N];
+            alignas(32) uint32_t cycles[N];
+            alignas(32) uint8_t mask[N]; /* Lanes taking part in the current instruction */
+
+            Status status[N];
+            Lane lanes[N];
+
+            uint8_t* reg8(unsigned int index); /* B, C, D, E, H, L, -, A as encoded in opcodes */
+            bool execute_group(uint8_t opcode, uint16_t at, Lane& code); /* Lane-wise kernels, false if there is none */
+
+            void advance(unsigned int cost, unsigned int length); /* Cycles and pc of the lanes in mask */
+            void ld(uint8_t* dst, const uint8_t* src, unsigned int cost);
+            void ld(uint8_t* dst, uint8_t value, unsigned int cost, unsigned int length);
+            void alu(unsigned int op, const uint8_t* src, unsigned int cost);
+            void alu(unsigned int op, uint8_t value, unsigned int cost, unsigned int length);
+            void inc(uint8_t* dst);
+            void dec(uint8_t* dst);
+            void jump(uint8_t condition, uint16_t target, unsigned int taken, unsigned int not_taken, unsigned int length);
+    };
+}
+
+#include "wide.tpp"
+
+#endif
@@ -0,0 +1,531 @@
+#include<cstring>
+#if defined(__AVX2__) || defined(__SSE2__)
+#include<immintrin.h>
+#endif
+
+namespace Z80
+{
+#if defined(__AVX2__) || defined(__SSE2__)
+    /* What the kernels need of a vector register: bytes holds one byte of
+     * as many lanes, widen16() and widen32() spread a mask of them over the
+     * 16 and 32 bit registers holding pc and cycles of the same lanes */
+    struct LaneVector
+    {
+#if defined(__AVX2__)
+        using Register = __m256i;
+        static constexpr unsigned int bytes = 32;
+
+        static Register load(const void* p) { return _mm256_loadu_si256(static_cast<const Register*>(p)); }
+        static void store(void* p, Register v) { _mm256_storeu_si256(static_cast<Register*>(p), v); }
+        static Register set8(uint8_t value) { return _mm256_set1_epi8(value); }
+        static Register set16(uint16_t value) { return _mm256_set1_epi16(value); }
+        static Register set32(uint32_t value) { return _mm256_set1_epi32(value); }
+        static Register zero() { return _mm256_setzero_si256(); }
+        static Register equal8(Register x, Register y) { return _mm256_cmpeq_epi8(x, y); }
+        static Register sub8(Register x, Register y) { return _mm256_sub_epi8(x, y); }
+        static Register add16(Register x, Register y) { return _mm256_add_epi16(x, y); }
+        static Register add32(Register x, Register y) { return _mm256_add_epi32(x, y); }
+        static Register and_(Register x, Register y) { return _mm256_and_si256(x, y); }
+        static Register andnot(Register x, Register y) { return _mm256_andnot_si256(x, y); } /* y and not x */
+        static Register select(Register m, Register yes, Register no) { return _mm256_blendv_epi8(no, yes, m); }
+
+        static void widen16(Register m, Register out[2])
+        {
+            out[0] = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(m));
+            out[1] = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(m, 1));
+        }
+        static void widen32(Register m, Register out[4])
+        {
+            __m128i low = _mm256_castsi256_si128(m), high = _mm256_extracti128_si256(m, 1);
+            out[0] = _mm256_cvtepi8_epi32(low);
+            out[1] = _mm256_cvtepi8_epi32(_mm_srli_si128(low, 8));
+            out[2] = _mm256_cvtepi8_epi32(high);
+            out[3] = _mm256_cvtepi8_epi32(_mm_srli_si128(high, 8));
+        }
+#else
+        using Register = __m128i;
+        static constexpr unsigned int bytes = 16;
+
+        static Register load(const void* p) { return _mm_loadu_si128(static_cast<const Register*>(p)); }
+        static void store(void* p, Register v) { _mm_storeu_si128(static_cast<Register*>(p), v); }
+        static Register set8(uint8_t value) { return _mm_set1_epi8(value); }
+        static Register set16(uint16_t value) { return _mm_set1_epi16(value); }
+        static Register set32(uint32_t value) { return _mm_set1_epi32(value); }
+        static Register zero() { return _mm_setzero_si128(); }
+        static Register equal8(Register x, Register y) { return _mm_cmpeq_epi8(x, y); }
+        static Register sub8(Register x, Register y) { return _mm_sub_epi8(x, y); }
+        static Register add16(Register x, Register y) { return _mm_add_epi16(x, y); }
+        static Register add32(Register x, Register y) { return _mm_add_epi32(x, y); }
+        static Register and_(Register x, Register y) { return _mm_and_si128(x, y); }
+        static Register andnot(Register x, Register y) { return _mm_andnot_si128(x, y); } /* y and not x */
+        static Register select(Register m, Register yes, Register no) { return _mm_or_si128(_mm_and_si128(m, yes), _mm_andnot_si128(m, no)); }
+
+        /* A byte unpacked with itself keeps the mask all ones or all zeros */
+        static void widen16(Register m, Register out[2])
+        {
+            out[0] = _mm_unpacklo_epi8(m, m);
+            out[1] = _mm_unpackhi_epi8(m, m);
+        }
+        static void widen32(Register m, Register out[4])
+        {
+            widen16(m, out + 2);
+            Register low = out[2], high = out[3];
+            out[0] = _mm_unpacklo_epi16(low, low);
+            out[1] = _mm_unpackhi_epi16(low, low);
+            out[2] = _mm_unpacklo_epi16(high, high);
+            out[3] = _mm_unpackhi_epi16(high, high);
+        }
+#endif
+        /* All ones in the lanes whose mask byte is 1 */
+        static Register active(const uint8_t* mask) { return sub8(zero(), load(mask)); }
+    };
+#endif
+
+    template <unsigned int N, class Variant>
+    Wide<N, Variant>::Wide()
+    {
+        memset(a, 0, sizeof(a)); memset(f, 0, sizeof(f));
+        memset(b, 0, sizeof(b)); memset(c, 0, sizeof(c));
+        memset(d, 0, sizeof(d)); memset(e, 0, sizeof(e));
+        memset(h, 0, sizeof(h)); memset(l, 0, sizeof(l));
+        memset(pc, 0, sizeof(pc));
+        memset(cycles, 0, sizeof(cycles));
+
+        for(unsigned int n = 0; n<N; ++n)
+        {
+            status[n] = Status::Ok;
+            lanes[n].store_to(*this, n);
+        }
+    }
+
+    template <unsigned int N, class Variant>
+    bool Wide<N, Variant>::load(const char* filename)
+    {
+        if(!lanes[0].load(filename))
+            return false;
+
+        for(unsigned int n = 1; n<N; ++n)
+            lanes[n].share_rom(lanes[0]);
+        return true;
+    }
+
+    template <unsigned int N, class Variant>
+    uint8_t* Wide<N, Variant>::get_memory(unsigned int lane)
+    {
+        return lanes[lane].memory_base();
+    }
+
+    template <unsigned int N, class Variant>
+    uint8_t* Wide<N, Variant>::get_ports(unsigned int lane)
+    {
+        return lanes[lane].ports_base();
+    }
+
+    template <unsigned int N, class Variant>
+    typename Wide<N, Variant>::Lane& Wide<N, Variant>::get_lane(unsigned int lane)
+    {
+        lanes[lane].load_from(*this, lane);
+        return lanes[lane];
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::set_lane(unsigned int lane)
+    {
+        lanes[lane].store_to(*this, lane);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::run(unsigned int budget)
+    {
+        uint32_t start[N];
+        memcpy(start, cycles, sizeof(cycles));
+
+        while(true)
+        {
+            /* Lanes with the lowest pc go first, so that lanes which took
+             * different branches meet again where the paths join */
+            unsigned int active = 0;
+            uint16_t at = 0xFFFF;
+            for(unsigned int n = 0; n<N; ++n)
+            {
+                if(status[n] != Status::Ok || cycles[n] - start[n] >= budget)
+                    continue;
+                if(active == 0 || pc[n] < at)
+                    at = pc[n];
+                active++;
+            }
+            if(active == 0)
+                break;
+
+            /* Lanes which switched to other banks wait for a later round */
+            unsigned int first = N;
+            for(unsigned int n = 0; n<N; ++n)
+            {
+                mask[n] = status[n] == Status::Ok && cycles[n] - start[n] < budget && pc[n] == at;
+                if(mask[n] && first == N)
+                    first = n;
+                else if(mask[n])
+                    mask[n] = lanes[n].maps_like(lanes[first]);
+            }
+
+            if(execute_group(lanes[first].fetch_at(at), at, lanes[first]))
+            {
+                for(unsigned int n = 0; n<N; ++n)
+                    if(mask[n])
+                        lanes[n].retire();
+                continue;
+            }
+
+            for(unsigned int n = 0; n<N; ++n)
+            {
+                if(!mask[n])
+                    continue;
+                lanes[n].load_from(*this, n);
+                lanes[n].step_one();
+                status[n] = lanes[n].get_status();
+                lanes[n].store_to(*this, n);
+            }
+        }
+    }
+
+    /* A lane stays Halted across run() until then, so it neither runs its
+     * halt again nor looks like a lane out of budget */
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::interrupt(unsigned int lane)
+    {
+        lanes[lane].load_from(*this, lane);
+        lanes[lane].interrupt();
+        lanes[lane].store_to(*this, lane);
+        if(status[lane] == Status::Halted)
+            status[lane] = Status::Ok;
+    }
+
+    template <unsigned int N, class Variant>
+    uint8_t* Wide<N, Variant>::reg8(unsigned int index)
+    {
+        uint8_t* registers[] = {b, c, d, e, h, l, nullptr, a};
+        return registers[index];
+    }
+
+    template <unsigned int N, class Variant>
+    bool Wide<N, Variant>::execute_group(uint8_t opcode, uint16_t at, Lane& code)
+    {
+        uint8_t n8 = code.fetch_at(at+1);
+        uint16_t n16 = code.fetch_at(at+2) << 8 | n8;
+        unsigned int dst = opcode >> 3 & 0x7;
+        unsigned int src = opcode & 0x7;
+
+        /* Instructions touching memory through (hl) are left to the scalar core */
+        switch(opcode)
+        {
+            case 0x00: /* nop */
+                advance(4, 1);
+                return true;
+            case 0x06: case 0x0E: case 0x16: case 0x1E: case 0x26: case 0x2E: case 0x3E: /* ld r, * */
+                ld(reg8(dst), n8, 7, 2);
+                return true;
+            case 0x04: case 0x0C: case 0x14: case 0x1C: case 0x24: case 0x2C: case 0x3C: /* inc r */
+                inc(reg8(dst));
+                return true;
+            case 0x05: case 0x0D: case 0x15: case 0x1D: case 0x25: case 0x2D: case 0x3D: /* dec r */
+                dec(reg8(dst));
+                return true;
+            case 0x18: /* jr * */
+                jump(0xFF, at + static_cast<int8_t>(n8) + 2, 12, 12, 2);
+                return true;
+            case 0x20: case 0x28: case 0x30: case 0x38: /* jr cc, * */
+                jump(opcode >> 3 & 0x3, at + static_cast<int8_t>(n8) + 2, 12, 7, 2);
+                return true;
+            case 0xC3: /* jp ** */
+                jump(0xFF, n16, 10, 10, 3);
+                return true;
+            case 0xC2: case 0xCA: case 0xD2: case 0xDA: /* jp cc, ** */
+                jump(opcode >> 3 & 0x3, n16, 10, 10, 3);
+                return true;
+            case 0xC6: case 0xD6: case 0xE6: case 0xEE: case 0xF6: case 0xFE: /* alu a, * */
+                alu(dst, n8, 7, 2);
+                return true;
+        }
+
+        if(opcode >= 0x40 && opcode < 0x80 && dst != 6 && src != 6) /* ld r, r' */
+        {
+            ld(reg8(dst), reg8(src), 4);
+            return true;
+        }
+        if(opcode >= 0x80 && opcode < 0xC0 && src != 6 && dst != 1 && dst != 3) /* alu a, r except adc and sbc */
+        {
+            alu(dst, reg8(src), 4);
+            return true;
+        }
+        return false;
+    }
+
+    /* Each kernel first goes through the lanes a vector register at a time,
+     * then through the lanes left over one by one. In both the mask applies
+     * as a select, so lanes out of the group keep their values. */
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::advance(unsigned int cost, unsigned int length)
+    {
+        unsigned int n = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+        using V = LaneVector;
+        for(; n + V::bytes <= N; n += V::bytes)
+        {
+            V::Register m = V::active(mask + n), m16[2], m32[4];
+            V::widen16(m, m16);
+            V::widen32(m, m32);
+            for(unsigned int k = 0; k<2; ++k)
+            {
+                uint16_t* p = pc + n + k*V::bytes/2;
+                V::store(p, V::add16(V::load(p), V::and_(m16[k], V::set16(length))));
+            }
+            for(unsigned int k = 0; k<4; ++k)
+            {
+                uint32_t* p = cycles + n + k*V::bytes/4;
+                V::store(p, V::add32(V::load(p), V::and_(m32[k], V::set32(cost))));
+            }
+        }
+#endif
+        for(; n<N; ++n)
+        {
+            cycles[n] += mask[n] ? cost : 0;
+            pc[n] += mask[n] ? length : 0;
+        }
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::ld(uint8_t* dst, const uint8_t* src, unsigned int cost)
+    {
+        unsigned int n = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+        using V = LaneVector;
+        for(; n + V::bytes <= N; n += V::bytes)
+            V::store(dst + n, V::select(V::active(mask + n), V::load(src + n), V::load(dst + n)));
+#endif
+        for(; n<N; ++n)
+            dst[n] = mask[n] ? src[n] : dst[n];
+        advance(cost, 1);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::ld(uint8_t* dst, uint8_t value, unsigned int cost, unsigned int length)
+    {
+        unsigned int n = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+        using V = LaneVector;
+        for(; n + V::bytes <= N; n += V::bytes)
+            V::store(dst + n, V::select(V::active(mask + n), V::set8(value), V::load(dst + n)));
+#endif
+        for(; n<N; ++n)
+            dst[n] = mask[n] ? value : dst[n];
+        advance(cost, length);
+    }
+
+    /* alu, inc and dec look their results up in tables one lane at a time,
+     * there is no byte gather to do it lane-wise */
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::alu(unsigned int op, const uint8_t* src, unsigned int cost)
+    {
+        const Tables& t = tables();
+        for(unsigned int n = 0; n<N; ++n)
+        {
+            uint8_t result = t.result[op][a[n]][src[n]];
+            uint8_t flags = t.flags[op][a[n]][src[n]] | (f[n] & t.kept[op]);
+            a[n] = mask[n] ? result : a[n];
+            f[n] = mask[n] ? flags : f[n];
+        }
+        advance(cost, 1);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::alu(unsigned int op, uint8_t value, unsigned int cost, unsigned int length)
+    {
+        const Tables& t = tables();
+        for(unsigned int n = 0; n<N; ++n)
+        {
+            uint8_t result = t.result[op][a[n]][value];
+            uint8_t flags = t.flags[op][a[n]][value] | (f[n] & t.kept[op]);
+            a[n] = mask[n] ? result : a[n];
+            f[n] = mask[n] ? flags : f[n];
+        }
+        advance(cost, length);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::inc(uint8_t* dst)
+    {
+        const Tables& t = tables();
+        for(unsigned int n = 0; n<N; ++n)
+        {
+            uint8_t flags = t.inc_flags[dst[n]] | (f[n] & t.inc_kept);
+            f[n] = mask[n] ? flags : f[n];
+            dst[n] = mask[n] ? t.inc_result[dst[n]] : dst[n];
+        }
+        advance(4, 1);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::dec(uint8_t* dst)
+    {
+        const Tables& t = tables();
+        for(unsigned int n = 0; n<N; ++n)
+        {
+            uint8_t flags = t.dec_flags[dst[n]] | (f[n] & t.dec_kept);
+            f[n] = mask[n] ? flags : f[n];
+            dst[n] = mask[n] ? t.dec_result[dst[n]] : dst[n];
+        }
+        advance(4, 1);
+    }
+
+    /* condition is 0 nz, 1 z, 2 nc, 3 c, 0xFF always */
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::jump(uint8_t condition, uint16_t target, unsigned int taken, unsigned int not_taken, unsigned int length)
+    {
+        uint8_t flag_mask = condition & 0x2 ? 0x01 : 0x40; /* CF or ZF */
+        uint8_t expected = condition & 0x1 ? flag_mask : 0x00;
+
+        unsigned int n = 0;
+#if defined(__AVX2__) || defined(__SSE2__)
+        using V = LaneVector;
+        for(; n + V::bytes <= N; n += V::bytes)
+        {
+            V::Register m = V::active(mask + n), take = m;
+            if(condition != 0xFF)
+                take = V::and_(m, V::equal8(V::and_(V::load(f + n), V::set8(flag_mask)), V::set8(expected)));
+            V::Register skip = V::andnot(take, m);
+
+            V::Register take16[2], skip16[2], take32[4], skip32[4];
+            V::widen16(take, take16);
+            V::widen16(skip, skip16);
+            V::widen32(take, take32);
+            V::widen32(skip, skip32);
+            for(unsigned int k = 0; k<2; ++k)
+            {
+                uint16_t* p = pc + n + k*V::bytes/2;
+                V::Register next = V::add16(V::load(p), V::and_(skip16[k], V::set16(length)));
+                V::store(p, V::select(take16[k], V::set16(target), next));
+            }
+            for(unsigned int k = 0; k<4; ++k)
+            {
+                uint32_t* p = cycles + n + k*V::bytes/4;
+                V::Register cost = V::add32(V::and_(take32[k], V::set32(taken)), V::and_(skip32[k], V::set32(not_taken)));
+                V::store(p, V::add32(V::load(p), cost));
+            }
+        }
+#endif
+        for(; n<N; ++n)
+        {
+            bool take = condition == 0xFF || (f[n] & flag_mask) == expected;
+            uint16_t next = take ? target : pc[n] + length;
+            pc[n] = mask[n] ? next : pc[n];
+            cycles[n] += mask[n] ? (take ? taken : not_taken) : 0;
+        }
+    }
+
+    template <unsigned int N, class Variant>
+    const typename Wide<N, Variant>::Tables& Wide<N, Variant>::tables()
+    {
+        /* Built once from the scalar core, so both always agree */
+        static const Tables* t = []()
+        {
+            Tables* t = new Tables;
+            Lane* scratch = new Lane;
+            uint8_t result, low, high;
+
+            for(unsigned int op = 0; op<8; ++op)
+            {
+                t->kept[op] = 0;
+                if(op == 1 || op == 3) /* adc and sbc read the carry, the scalar core runs them */
+                    continue;
+
+                for(unsigned int x = 0; x<256; ++x)
+                    for(unsigned int y = 0; y<256; ++y)
+                    {
+                        scratch->alu(0x80 | op << 3, x, y, 0x00, result, low);
+                        scratch->alu(0x80 | op << 3, x, y, 0xFF, result, high);
+                        t->result[op][x][y] = result;
+                        t->flags[op][x][y] = low;
+                        t->kept[op] |= low ^ high;
+                    }
+            }
+
+            t->inc_kept = t->dec_kept = 0;
+            for(unsigned int x = 0; x<256; ++x)
+            {
+                scratch->alu(0x04, 0, x, 0x00, t->inc_result[x], low);
+                scratch->alu(0x04, 0, x, 0xFF, result, high);
+                t->inc_flags[x] = low;
+                t->inc_kept |= low ^ high;
+
+                scratch->alu(0x05, 0, x, 0x00, t->dec_result[x], low);
+                scratch->alu(0x05, 0, x, 0xFF, result, high);
+                t->dec_flags[x] = low;
+                t->dec_kept |= low ^ high;
+            }
+
+            delete scratch;
+            return t;
+        }();
+
+        return *t;
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::Lane::load_from(Wide& w, unsigned int n)
+    {
+        this->A() = w.a[n]; this->F() = w.f[n];
+        this->B() = w.b[n]; this->C() = w.c[n];
+        this->D() = w.d[n]; this->E() = w.e[n];
+        this->H() = w.h[n]; this->L() = w.l[n];
+        this->pc = w.pc[n];
+        this->cycles = w.cycles[n];
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::Lane::store_to(Wide& w, unsigned int n)
+    {
+        w.a[n] = this->A(); w.f[n] = this->F();
+        w.b[n] = this->B(); w.c[n] = this->C();
+        w.d[n] = this->D(); w.e[n] = this->E();
+        w.h[n] = this->H(); w.l[n] = this->L();
+        w.pc[n] = this->pc;
+        w.cycles[n] = this->cycles;
+    }
+
+    template <unsigned int N, class Variant>
+    bool Wide<N, Variant>::Lane::maps_like(const Lane& other) const
+    {
+        if(!this->banked && !other.banked)
+            return true;
+        return memcmp(this->rom_banks, other.rom_banks, sizeof(this->rom_banks)) == 0;
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::Lane::retire()
+    {
+        this->m1++;
+        if constexpr(Variant::metrics)
+            this->metrics.instructions.add(1);
+    }
+
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::Lane::share_rom(const Lane& owner)
+    {
+        this->rom = owner.rom;
+        this->rom_size = owner.rom_size;
+    }
+
+    /* Runs an operation of A with B on the scalar core */
+    template <unsigned int N, class Variant>
+    void Wide<N, Variant>::Lane::alu(uint8_t opcode, uint8_t a, uint8_t operand, uint8_t flags, uint8_t& result, uint8_t& new_flags)
+    {
+        this->A() = a;
+        this->B() = operand;
+        this->F() = flags;
+        this->execute(opcode);
+        result = (opcode & 0xC0) == 0x80 ? this->A() : this->B();
+        new_flags = this->F();
+    }
+}
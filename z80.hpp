@@ -2,33 +2,150 @@
 #define Z80_H
 
 #include<cstdint>
+#include<bitset>
+
+#include "variant.hpp"
+#include "dirty.hpp"
+#include "pacing.hpp"
+#include "metrics.hpp"
 
 namespace Z80
 {
+    /* Register pair, hi() is the register named first (A in AF, B in BC) */
     union Register
     {
         uint16_t p;   /* pair of registers */
-        uint8_t r[2]; /* separate registers */
+        uint8_t r[2]; /* separate registers, in host byte order */
+
+        constexpr uint8_t& hi() { return r[high]; }
+        constexpr uint8_t& lo() { return r[low]; }
+        constexpr uint8_t hi() const { return r[high]; }
+        constexpr uint8_t lo() const { return r[low]; }
+
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        static constexpr unsigned int high = 0, low = 1;
+#else
+        static constexpr unsigned int high = 1, low = 0;
+#endif
     };
 
-    class Z80
+    class GDBStub;
+    class Journal;
+    struct RomImage;
+    class FrameExport;
+    class Profiler;
+    class Symbols;
+    struct State;
+
+    /* Why run() returned */
+    enum class Status
     {
+        Ok,              /* Still running */
+        Unimplemented,   /* pc is left on the unknown instruction */
+        Halted,          /* halt was executed, waiting for an interrupt */
+        Breakpoint,      /* pc reached a breakpoint, not yet executed */
+        BudgetExhausted  /* The cycle budget was used up */
+    };
+
+    /* The interpreter. Derived is the host machine (CRTP): the core calls
+     * fetch, read_memory, get_memory, contend, port_in, port_out, execute
+     * and end_frame through it, so a host redefining them gets them inlined in the
+     * dispatch loop. Redefined hooks must be public. Hosts which need
+     * virtual functions derive from VirtualZ80 instead. */
+    template <class Derived, class Variant = variant::Accurate>
+    class Z80Core
+    {
+        friend class GDBStub;
+
         public:
-            Z80();
-            ~Z80() {}
-            virtual void step();
-            virtual uint8_t fetch(int offset);
-            virtual bool load(const char* filename); /* Loads ROM */
-            virtual void execute(uint8_t opcode);
+            Z80Core();
+            ~Z80Core();
+            Z80Core(const Z80Core&) = delete; /* Holds a reference on the ROM mapping */
+            Z80Core& operator=(const Z80Core&) = delete;
+            Status step(); /* Runs a frame and waits for its end in real time, see run() */
+            uint8_t fetch(int offset);
+            bool load(const char* filename); /* Maps the ROM file, shared with the CPUs which loaded the same ROM */
+            void execute(uint8_t opcode);
+
+            Status run(unsigned int budget); /* Executes for about budget cycles, never sleeps */
+            /* step() returns BudgetExhausted for a frame run to its end, halted or not,
+             * and Unimplemented or Breakpoint for one which stopped early */
+            Status get_status() const { return status; }
+            void set_breakpoint(uint16_t address, bool value);
+            void clear_breakpoints();
+
+            void interrupt(); /* Ignored while a journal is replayed, which brings its own */
+
+            /* Record or replay of port reads and interrupts (journal.hpp), null to stop */
+            void set_journal(Journal* journal);
+            uint64_t elapsed() const { return clock_base + cycles; } /* T-states, kept going across step() */
+
+            /* Save states, see savestate.hpp */
+            bool save_state(const char* filename, bool compress = false);
+            bool load_state(const char* filename);
+            void save_state(State& state);
+            void load_state(const State& state);
+
+            /* Persistent fuzzing, restore() goes back to the state taken by snapshot()
+             * by copying registers, ports and only the memory pages written since */
+            void snapshot(State& state);
+            void restore(const State& state);
+
+            /* Names printed next to pc in traces (symbols.hpp), null for addresses only */
+            void set_symbols(const Symbols* symbols) { this->symbols = symbols; }
+
+            /* Sampling profiler (profiler.hpp) checked between instructions, null to stop */
+            void set_profiler(Profiler* profiler) { this->profiler = profiler; }
+
+            /* Performance counters, readable from other threads, see metrics.hpp */
+            const Metrics& get_metrics() const { return metrics; }
+
+            /* Real-time pacing of step(), see pacing.hpp */
+            Pacer& get_pacer() { return pacer; }
+
+            /* Memory ranges published at the end of each frame of step(), see frame.hpp. Null to stop */
+            void set_frame_export(FrameExport* frame_export) { this->frame_export = frame_export; }
+
+            /* Pages written since the host last cleared them, for rendering or
+             * syncing only what changed. Kept apart from snapshot() and restore() */
+            DirtyRanges dirty_ranges() const { return DirtyRanges(written_pages); }
+            bool is_dirty(uint16_t address) const { return written_pages[address >> 14] >> (address >> 8 & 63) & 1; }
+            void clear_dirty() { written_pages[0] = written_pages[1] = written_pages[2] = written_pages[3] = 0; }
+
+            /* Bank switching, for images larger than the 64 KB the CPU sees. The code
+             * space is four slots of 16 KB, each showing a 16 KB bank of the image.
+             * Banks past the end of the image read as 0xFF. */
+            void map_bank(unsigned int slot, unsigned int bank);
+            void set_bank_port(uint8_t port, unsigned int slot);         /* An out to port selects the bank of slot */
+            void set_bank_register(uint16_t address, unsigned int slot); /* So does a write to address */
+
+            /* Memory contention, for machines where the video hardware steals bus cycles */
+            void set_contended(uint16_t start, uint16_t end, bool value); /* Pages holding [start, end] */
+            void set_contention_table(const uint8_t* delays, unsigned int length); /* Wait states by T-state of the frame */
+
+            /* Opcode pair profile, counts[previous << 8 | opcode] with variant::Profile */
+            void set_pair_counts(uint32_t* counts) { pair_counts = counts; }
+
+            /* Edge coverage bitmap of 65536 bytes with variant::Coverage */
+            void set_coverage_map(uint8_t* map) { coverage_map = map; prev_location = 0; }
+
+            void set_port(uint8_t port, uint8_t value) { ports[port] = value; } /* Read back by the default port_in */
+            void poke(uint16_t address, uint8_t value); /* Host write: not contended, but seen by dirty pages and bank registers */
 
-            void interrupt();
+            /* Default bus hooks */
+            uint8_t& get_memory(uint16_t address);  /* Memory path for writes */
+            uint8_t read_memory(uint16_t address);  /* Memory path for reads */
+            void contend(uint16_t address);         /* Wait states of an access */
+            uint8_t port_in(uint8_t port);
+            void port_out(uint8_t port, uint8_t value);
+            void end_frame();                       /* Called by step() once the frame has run */
 
         protected:
             /* Main registers */
-            Register AF; uint8_t* A = &(AF.r[0]); uint8_t* F = &(AF.r[1]); /* Bit 	7 	6 	5 	4 	3 	2 	1 	0 */
-            Register BC; uint8_t* B = &(BC.r[0]); uint8_t* C = &(BC.r[1]); /* Flag 	S 	Z 	F5 	H 	F3 	P/V N 	C */
-            Register DE; uint8_t* D = &(DE.r[0]); uint8_t* E = &(DE.r[1]);
-            Register HL; uint8_t* H = &(HL.r[0]); uint8_t* L = &(HL.r[1]);
+            Register AF; uint8_t& A() { return AF.hi(); } uint8_t& F() { return AF.lo(); } /* Bit 	7 	6 	5 	4 	3 	2 	1 	0 */
+            Register BC; uint8_t& B() { return BC.hi(); } uint8_t& C() { return BC.lo(); } /* Flag 	S 	Z 	F5 	H 	F3 	P/V N 	C */
+            Register DE; uint8_t& D() { return DE.hi(); } uint8_t& E() { return DE.lo(); }
+            Register HL; uint8_t& H() { return HL.hi(); } uint8_t& L() { return HL.lo(); }
 
             /* Alternate registers */
             Register AF_;
@@ -37,23 +154,70 @@ namespace Z80
             Register HL_;
 
             /* Index registers */
-            Register INDEX_X = {0}; uint8_t ixl = INDEX_X.r[0]; uint8_t ixh = INDEX_X.r[0]; uint16_t ix = INDEX_X.p; /* Index X */
-            uint16_t iy; /* Index Y */
+            Register IX = {0}; /* Index X, IX.hi() and IX.lo() are IXH and IXL */
+            Register IY = {0}; /* Index Y */
             uint16_t sp; /* Stack pointer */
 
             /* Other registers */
             uint8_t i; /* Interrupt vector */ 
-            uint8_t r; /* Refresh counter */
+            uint8_t r; /* Refresh counter as last written, see refresh() */
+            unsigned int m1 = 0;   /* Opcode fetches retired, prefixes included */
+            unsigned int r_m1 = 0; /* Value of m1 when r was written */
 
             uint16_t pc = 0; /* Program counter */
 
             uint8_t memory[65536]; /* Random Access Memory */
-            uint8_t* rom;          /* Read-Only Memory */
-            unsigned int rom_size; /* Size of the ROM file */
+            uint8_t* rom = nullptr; /* Read-Only Memory, mapped from the file */
+            unsigned int rom_size = 0; /* Size of the ROM file */
+            RomImage* rom_image = nullptr; /* Reference held on the mapping, see romcache.hpp */
             uint8_t ports[256];    /* I/O ports */
 
             bool pins[40]; /* I/O pins */
 
+            Status status = Status::Ok;
+            std::bitset<65536> breakpoints;
+            unsigned int breakpoint_count = 0;
+
+            uint64_t dirty_pages[4] = {0};   /* One bit per 256 bytes page written since the last snapshot */
+            uint64_t written_pages[4] = {0}; /* The same since the host last called clear_dirty() */
+            void mark_dirty(uint16_t address)
+            {
+                uint64_t bit = 1ull << (address >> 8 & 63);
+                dirty_pages[address >> 14] |= bit;
+                written_pages[address >> 14] |= bit;
+            }
+
+            uint32_t rom_banks[4] = {0x0000, 0x4000, 0x8000, 0xC000}; /* Offset in the image of each slot */
+            bool banked = false;              /* The code space may change at run time */
+            int8_t bank_ports[256];           /* Slot switched by an out to each port, -1 for none */
+            uint16_t bank_registers[4];       /* Address switching each slot */
+            uint8_t bank_register_values[4];  /* Value of each register when last looked at */
+            uint8_t bank_register_slots = 0;  /* One bit per slot with a bank register */
+            bool bank_write = false;          /* Memory was written while bank registers exist */
+
+            bool contended[256] = {false};              /* One entry per 256 bytes page */
+            const uint8_t* contention_delays = nullptr; /* Owned by the host machine */
+            unsigned int contention_length = 0;
+            unsigned int access_time = 0;               /* T-state of the next bus access of the instruction */
+
+            bool fusing = false;               /* Set by run() when nothing can stop between two instructions */
+            uint32_t* pair_counts = nullptr;   /* Owned by the host */
+            uint8_t last_opcode = 0;
+
+            Journal* journal = nullptr; /* Owned by the host */
+            uint64_t journal_start = 0;
+            uint64_t clock_base = 0;    /* T-states of the previous frames */
+
+            Pacer pacer;
+            Profiler* profiler = nullptr; /* Owned by the host */
+            const Symbols* symbols = nullptr;
+            Metrics metrics;
+
+            FrameExport* frame_export = nullptr; /* Owned by the host, read by another thread */
+
+            uint8_t* coverage_map = nullptr; /* Owned by the host, usually shared with the fuzzer */
+            uint16_t prev_location = 0;
+
             /* Interrupt flip-flops */
             bool iff1 = false;
             bool iff2 = false;
@@ -74,6 +238,7 @@ namespace Z80
             void bitwise_xor(unsigned int src);
             void bitwise_or(unsigned int src);
             void cp(unsigned int src);
+            void alu(uint8_t operation, unsigned int value); /* add, adc, sub, sbc, and, xor, or, cp as encoded in opcodes */
 
             void rlca();
             void rla();
@@ -108,6 +273,7 @@ namespace Z80
             void sla(uint8_t* m);
             void sra(uint8_t* m);
             void srl(uint8_t* m);
+            void sll(uint8_t* m);
 
             void bit(uint8_t b, uint8_t* m);
             void res(uint8_t b, uint8_t* m);
@@ -133,18 +299,78 @@ namespace Z80
             template<class T> unsigned int twoscomp(T bin);
             bool parity_check(unsigned int bin);
             uint16_t get_operand(int offset);
-            uint8_t& get_memory(uint16_t address);
+            uint8_t get_register(uint8_t index);    /* B, C, D, E, H, L, (HL), A as encoded in opcodes */
+            uint8_t* register_operand(uint8_t index); /* Same without (HL) */
 
             void interpret_extd(uint8_t opcode);
             void interpret_bits(uint8_t opcode);
-            void interpret_ix(uint8_t opcode);
+            template <Register Z80Core::*Index> void interpret_index(uint8_t opcode);
+            template <Register Z80Core::*Index> void interpret_index_bits(uint8_t opcode, uint16_t address);
+            template <Register Z80Core::*Index> uint8_t& index_register(uint8_t index);
+            bool bit_operation(uint8_t opcode, uint8_t* m);
+            void load_registers(const State& state); /* Everything but memory and ports */
+            uint8_t input(uint8_t port);  /* Port reads, through the journal when there is one */
+            void output(uint8_t port, uint8_t value); /* Port writes, through the bank ports */
+            void update_banks(); /* Looks at the bank registers after an instruction wrote to memory */
+            void latch_bank_registers(); /* Takes the bank register values of memory as current */
+            void unload();
+            bool own_rom(); /* Replaces a shared ROM by a copy before it is written to, false if it stays read-only */
+            void accept_interrupt();
+            void replay_interrupts();
+            bool fuse(uint8_t next); /* Whether the following opcode is next and can run with this one */
+            void cover(); /* Records the edge to pc after a taken jump, call, return or restart */
+            void sample(); /* Hands pc, sp and the return addresses on the stack to the profiler */
+
+            /* Code bytes as seen through the banks, null past the end of the image */
+            uint8_t* rom_location(uint16_t address)
+            {
+                uint32_t offset = rom_banks[address >> 14] + (address & 0x3FFF);
+                return offset < rom_size ? rom + offset : nullptr;
+            }
+            uint8_t rom_byte(uint16_t address) { uint8_t* code = rom_location(address); return code ? *code : 0xFF; }
+
+            /* R only matters when it is read, so its 7 low bits are derived from m1 then */
+            uint8_t refresh() const { return (r & 0x80) | ((r + (m1 - r_m1)) & 0x7F); }
+            void set_refresh(uint8_t value) { r = value; r_m1 = m1; }
 
             unsigned int cycles; /* Variable used to count CPU cycles used by instructions */
             unsigned int cpu_frequency; /* CPU frequency in Hz */
             unsigned int refresh_rate; /* Display refresh rate in Hz */
+            unsigned int paced_rate;   /* refresh_rate the pacer period was set from */
+
+            Derived& derived() { return static_cast<Derived&>(*this); }
+    };
+
+    /* Former Z80 class, with its virtual functions for hosts overriding them */
+    template <class Variant>
+    class VirtualZ80 : public Z80Core<VirtualZ80<Variant>, Variant>
+    {
+        public:
+            virtual ~VirtualZ80() {}
+            virtual Status step() { return Z80Core<VirtualZ80, Variant>::step(); }
+            virtual uint8_t fetch(int offset) { return Z80Core<VirtualZ80, Variant>::fetch(offset); }
+            virtual bool load(const char* filename) { return Z80Core<VirtualZ80, Variant>::load(filename); }
+            virtual void execute(uint8_t opcode) { Z80Core<VirtualZ80, Variant>::execute(opcode); }
+            virtual void end_frame() { Z80Core<VirtualZ80, Variant>::end_frame(); }
+    };
+
+    using Z80 = VirtualZ80<variant::Accurate>;
+    using CMOSZ80 = VirtualZ80<variant::CMOS>;
+
+    /* No virtual function at all */
+    class FastZ80 : public Z80Core<FastZ80, variant::Fast>
+    {
     };
 }
 
 #include "z80.tpp"
 
+namespace Z80
+{
+    /* Instantiated once in z80.cpp */
+    extern template class Z80Core<Z80, variant::Accurate>;
+    extern template class Z80Core<CMOSZ80, variant::CMOS>;
+    extern template class Z80Core<FastZ80, variant::Fast>;
+}
+
 #endif
@@ -1,13 +1,2629 @@
+#include<algorithm>
+#include<cstring>
+#include<cstdio>
+#include<iostream>
+
+#include<sys/mman.h>
+
+#include "savestate.hpp"
+#include "journal.hpp"
+#include "opcodes.hpp"
+#include "romcache.hpp"
+#include "frame.hpp"
+#include "profiler.hpp"
+#include "symbols.hpp"
+
+#define OUT(DST, SRC) output(DST, SRC)
+#define IN(DST, SRC) DST = input(SRC)
+
 namespace Z80
 {
+    template <class Derived, class Variant>
+    Z80Core<Derived, Variant>::Z80Core()
+    {
+        cpu_frequency = 4.8 * 1000000;
+        refresh_rate = 60;
+        paced_rate = refresh_rate;
+        pacer.set_period(std::chrono::nanoseconds(1000000000 / refresh_rate));
+        memset(bank_ports, -1, sizeof(bank_ports));
+    }
+
+    template <class Derived, class Variant>
+    Z80Core<Derived, Variant>::~Z80Core()
+    {
+        unload();
+    }
+
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::load(const char* filename)
+    {
+        RomImage* image = acquire_rom(filename);
+
+        if(!image)
+        {
+            printf("Cannot load %s\n", filename);
+            return false;
+        }
+
+        unload();
+        rom_image = image;
+        rom = image->data;
+        rom_size = image->size;
+        for(unsigned int slot = 0; slot<4; ++slot)
+            rom_banks[slot] = slot << 14;
+        return true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::unload()
+    {
+        if(rom_image)
+            release_rom(rom_image);
+        rom_image = nullptr;
+        rom = nullptr;
+        rom_size = 0;
+    }
+
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::own_rom()
+    {
+        if(!rom_image || !rom_image->shared)
+            return true;
+
+        RomImage* copy = copy_rom(*rom_image);
+        if(!copy)
+            return false;
+        release_rom(rom_image);
+        rom_image = copy;
+        rom = copy->data;
+        return true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::map_bank(unsigned int slot, unsigned int bank)
+    {
+        uint32_t offset = bank << 14;
+
+        rom_banks[slot & 3] = offset;
+        banked = true;
+        if(rom_image && offset < rom_size) /* Starts reading the bank in before it is fetched from */
+            madvise(rom + offset, std::min(rom_size - offset, 0x4000u), MADV_WILLNEED);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_bank_port(uint8_t port, unsigned int slot)
+    {
+        bank_ports[port] = slot & 3;
+        banked = true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_bank_register(uint16_t address, unsigned int slot)
+    {
+        slot &= 3;
+        bank_registers[slot] = address;
+        bank_register_values[slot] = memory[address];
+        bank_register_slots |= 1 << slot;
+        banked = true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::poke(uint16_t address, uint8_t value)
+    {
+        memory[address] = value;
+        mark_dirty(address);
+        if(bank_register_slots)
+            update_banks();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::update_banks()
+    {
+        bank_write = false;
+        for(unsigned int slot = 0; slot<4; ++slot)
+        {
+            if(!(bank_register_slots >> slot & 1) || memory[bank_registers[slot]] == bank_register_values[slot])
+                continue;
+            bank_register_values[slot] = memory[bank_registers[slot]];
+            map_bank(slot, bank_register_values[slot]);
+        }
+    }
+
+    /* After a state is loaded the banks come from the state, the registers
+     * in the restored memory must not switch them again */
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::latch_bank_registers()
+    {
+        for(unsigned int slot = 0; slot<4; ++slot)
+            if(bank_register_slots >> slot & 1)
+                bank_register_values[slot] = memory[bank_registers[slot]];
+        bank_write = false;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::execute(uint8_t opcode)
+    {
+        [[maybe_unused]] uint16_t start = pc;
+        if constexpr(Variant::trace)
+        {
+            Instruction instruction;
+            std::cout << std::hex << "PC: " << (uint)pc;
+            if(symbols)
+                std::cout << " " << symbols->describe(pc);
+            std::cout << std::endl;
+            std::cout << std::hex << "opcode: " << (uint)opcode << std::endl;
+            /* The tables work on linear images, switched slots are not decoded */
+            if(rom_banks[pc >> 14] == (pc & 0xC000u) && decode(rom, rom_size, pc, instruction))
+                std::cout << instruction.text << std::endl;
+        }
+
+        if constexpr(Variant::pair_counts)
+        {
+            if(pair_counts)
+                pair_counts[last_opcode << 8 | opcode]++;
+            last_opcode = opcode;
+        }
+
+        m1++;
+        if constexpr(Variant::metrics)
+            metrics.instructions.add(1);
+        if constexpr(Variant::contention)
+            access_time = cycles + 4; /* Past the opcode fetch */
+        uint8_t low_nibble = opcode & 0xF;
+
+        switch (opcode)
+        {
+            case 0x00: /* nop */
+                cycles += 4;
+                pc++; break;
+            case 0x01: /* ld bc, ** */
+                cycles += 10;
+                ld(BC.p, get_operand(2));
+                pc += 3; break;
+            case 0x02: /* ld (bc), a */
+                cycles += 7;
+                ld(derived().get_memory(BC.p), A());
+                pc++; break;
+            case 0x03: /* inc bc */
+                cycles += 6;
+                inc(BC.p);
+                pc++; break;
+            case 0x04: /* inc b */
+                cycles += 4;
+                inc(B());
+                pc++; break;
+            case 0x05: /* dec b */
+                cycles += 4;
+                dec(B());
+                if(fuse(0x20)) /* jr nz, *, tested on b rather than on the flags */
+                {
+                    if(B()) {cycles += 12; pc += static_cast<int8_t>(derived().fetch(2))+3; cover();}
+                    else {cycles += 7; pc += 3;}
+                    break;
+                }
+                pc++; break;
+            case 0x06: /* ld b, * */
+                cycles += 7;
+                ld(B(), get_operand(1));
+                pc += 2; break;
+            case 0x07: /* rlca */
+                cycles += 4;
+                rlca();
+                pc++; break;
+            case 0x08: /* ex af, af' */
+                cycles += 4;
+                std::swap(AF.p, AF_.p);
+                pc++; break;
+            case 0x09: /* add hl, bc */
+                cycles += 11;
+                add(HL.p, BC.p);
+                pc++; break;
+            case 0x0A: /* ld a, (bc) */
+                cycles += 7;
+                ld(A(), derived().read_memory(BC.p));
+                pc++; break;
+            case 0x0B: /* dec bc */
+                cycles += 6;
+                dec(BC.p);
+                pc++; break;
+            case 0x0C: /* inc c */
+                cycles += 4;
+                inc(C());
+                pc++; break;
+            case 0x0D: /* dec c */
+                cycles += 4;
+                dec(C());
+                pc++; break;
+            case 0x0E: /* ld c, * */
+                cycles += 7;
+                ld(C(), get_operand(1));
+                pc += 2; break;
+            case 0x0F: /* rrca */
+                cycles += 4;
+                rrca();
+                pc++; break;
+            
+            case 0x10: /* djnz */
+                djnz(static_cast<int8_t>(get_operand(1))); /* Cycle incrementation inside of function */
+                break;
+            case 0x11: /* ld de, ** */
+                cycles += 10;
+                ld(DE.p, get_operand(2));
+                pc += 3; break;
+            case 0x12: /* ld (de), a */
+                cycles += 7;
+                ld(derived().get_memory(DE.p), A());
+                if(fuse(0x13)) /* inc de */
+                {
+                    cycles += 6;
+                    DE.p++;
+                    pc++;
+                }
+                pc++; break;
+            case 0x13: /* inc de */
+                cycles += 6;
+                inc(DE.p);
+                pc++; break;
+            case 0x14: /* inc d */
+                cycles += 4;
+                inc(D());
+                pc++; break;
+            case 0x15: /* dec d */
+                cycles += 4;
+                dec(D());
+                pc++; break;
+            case 0x16: /* ld d, * */
+                cycles += 7;
+                ld(D(), get_operand(1));
+                pc += 2; break;
+            case 0x17: /* rla */
+                cycles += 4;
+                rla();
+                pc++; break;
+            case 0x18: /* jr * */
+                cycles += 12;
+                pc += static_cast<int8_t>(get_operand(1))+2; cover(); break;
+            case 0x19: /* add hl, de */
+                cycles += 11;
+                add(HL.p, DE.p);
+                pc++; break;
+            case 0x1A: /* ld a, (de) */
+                cycles += 7;
+                ld(A(), derived().read_memory(DE.p));
+                if(fuse(0x13)) /* inc de */
+                {
+                    cycles += 6;
+                    DE.p++;
+                    pc++;
+                }
+                pc++; break;
+            case 0x1B: /* dec de */
+                cycles += 6;
+                dec(DE.p);
+                pc++; break;
+            case 0x1C: /* inc e */
+                cycles += 4;
+                inc(E());
+                pc++; break;
+            case 0x1D: /* dec e */
+                cycles += 4;
+                dec(E());
+                pc++; break;
+            case 0x1E: /* ld e, * */
+                cycles += 7;
+                ld(E(), get_operand(1));
+                pc += 2; break;
+            case 0x1F: /* rra */
+                cycles += 4;
+                rra();
+                pc++; break;
+            
+            case 0x20: /* jr nz, * */
+                if(!get_flag(6)) {cycles += 12; pc += static_cast<int8_t>(get_operand(1))+2; cover();}
+                else {cycles += 7; pc += 2;}
+                break;
+            case 0x21: /* ld hl, ** */
+                cycles += 10;
+                ld(HL.p, get_operand(2));
+                pc += 3; break;
+            case 0x22: /* ld (**), hl */
+                cycles += 16;
+                {
+                    uint16_t address = get_operand(2);
+                    ld(derived().get_memory(address), HL.lo());
+                    ld(derived().get_memory(address+1), HL.hi());
+                }
+                pc += 3; break;
+            case 0x23: /* inc hl */
+                cycles += 6;
+                inc(HL.p);
+                pc++; break;
+            case 0x24: /* inc h */
+                cycles += 4;
+                inc(H());
+                pc++; break;
+            case 0x25: /* dec h */
+                cycles += 4;
+                dec(H());
+                pc++; break;
+            case 0x26: /* ld h, * */
+                cycles += 7;
+                ld(H(), get_operand(1));
+                pc += 2; break;
+            case 0x27: /* daa */
+                cycles += 4;
+                daa();
+                pc++; break;
+            case 0x28: /* jr z, * */
+                if(get_flag(6)) {cycles += 12; pc += static_cast<int8_t>(get_operand(1))+2; cover();}
+                else {cycles += 7; pc += 2;}
+                break;
+            case 0x29: /* add hl, hl */
+                cycles += 11;
+                add(HL.p, HL.p);
+                pc++; break;
+            case 0x2A: /* ld hl, (**) */
+                cycles += 16;
+                {
+                    uint16_t address = get_operand(2);
+                    ld(L(), derived().read_memory(address));
+                    ld(H(), derived().read_memory(address+1));
+                }
+                pc += 3; break;
+            case 0x2B: /* dec hl */
+                cycles += 6;
+                dec(HL.p);
+                pc++; break;
+            case 0x2C: /* inc l */
+                cycles += 4;
+                inc(L());
+                pc++; break;
+            case 0x2D: /* dec l */
+                cycles += 4;
+                dec(L());
+                pc++; break;
+            case 0x2E: /* ld l, * */
+                cycles += 7;
+                ld(L(), get_operand(1));
+                pc += 2; break;
+            case 0x2F: /* cpl */
+                cycles += 4;
+                cpl();
+                pc++; break;
+            
+            case 0x30: /* jr nc, * */
+                if(!get_flag(0)) {cycles += 12; pc += static_cast<int8_t>(get_operand(1))+2; cover();}
+                else {cycles += 7; pc += 2;}
+                break;
+            case 0x31: /* ld sp, ** */
+                cycles += 10;
+                ld(sp, get_operand(2));
+                pc += 3; break;
+            case 0x32: /* ld (**), a */
+                cycles += 13;
+                ld(derived().get_memory(get_operand(2)), A());
+                pc += 3; break;
+            case 0x33:
+                cycles += 6;
+                inc(sp);
+                pc++; break;
+            case 0x34:
+                cycles += 11;
+                inc(derived().get_memory(HL.p));
+                pc++; break;
+            case 0x35:
+                cycles += 11;
+                dec(derived().get_memory(HL.p));
+                pc++; break;
+            case 0x36:
+                cycles += 10;
+                ld(derived().get_memory(HL.p), get_operand(1));
+                pc += 2; break;
+            case 0x37: /* scf */
+                cycles += 4;
+                set_CF(true);
+                pc++; break;
+            case 0x38: /* jr c, * */
+                if(get_flag(0)) {cycles += 12; pc += static_cast<int8_t>(get_operand(1))+2; cover();}
+                else {cycles += 7; pc += 2;}
+                break;
+            case 0x39:
+                cycles += 11;
+                add(HL.p, sp);
+                pc++; break;
+            case 0x3A:
+                cycles += 13;
+                ld(A(), derived().read_memory(get_operand(2)));
+                pc += 3; break;
+            case 0x3B:
+                cycles += 6;
+                dec(sp);
+                pc++; break;
+            case 0x3C:
+                cycles += 4;
+                inc(A());
+                pc++; break;
+            case 0x3D:
+                cycles += 4;
+                dec(A());
+                pc++; break;
+            case 0x3E:
+                cycles += 7;
+                ld(A(), get_operand(1));
+                pc += 2; break;
+            case 0x3F: /* ccf */
+                cycles += 4;
+                set_CF(!(F() & 0x1));
+                pc++; break;
+            
+            case 0x46:
+                cycles += 3;
+            case 0x40:
+            case 0x41:
+            case 0x42:
+            case 0x43:
+            case 0x44:
+            case 0x45:
+            case 0x47:
+                cycles += 4;
+                ld(B(), get_register(low_nibble));
+                pc++; break;
+            case 0x4E:
+                cycles += 3; 
+            case 0x48:
+            case 0x49:
+            case 0x4A:
+            case 0x4B:
+            case 0x4C:
+            case 0x4D:
+            case 0x4F:
+                cycles += 4;
+                ld(C(), get_register(low_nibble - 0x8));
+                pc++; break;
+            
+            case 0x56:
+                cycles += 3;
+            case 0x50:
+            case 0x51:
+            case 0x52:
+            case 0x53:
+            case 0x54:
+            case 0x55:
+            case 0x57:
+                cycles += 4;
+                ld(D(), get_register(low_nibble));
+                pc++; break;
+            case 0x5E:
+                cycles += 3; 
+            case 0x58:
+            case 0x59:
+            case 0x5A:
+            case 0x5B:
+            case 0x5C:
+            case 0x5D:
+            case 0x5F:
+                cycles += 4;
+                ld(E(), get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0x66:
+                cycles += 3;
+            case 0x60:
+            case 0x61:
+            case 0x62:
+            case 0x63:
+            case 0x64:
+            case 0x65:
+            case 0x67:
+                cycles += 4;
+                ld(H(), get_register(low_nibble));
+                pc++; break;
+            case 0x6E:
+                cycles += 3;
+            case 0x68:
+            case 0x69:
+            case 0x6A:
+            case 0x6B:
+            case 0x6C:
+            case 0x6D:
+            case 0x6F:
+                cycles += 4;
+                ld(L(), get_register(low_nibble - 0x8));
+                pc++; break;
+                
+            case 0x70:
+            case 0x71:
+            case 0x72:
+            case 0x73:
+            case 0x74:
+            case 0x75:
+            case 0x77:
+                cycles += 7;
+                ld(derived().get_memory(HL.p), get_register(low_nibble));
+                pc++; break;
+            case 0x76: /* halt */
+                cycles += 4;
+                pins[17] = true;
+                status = Status::Halted;
+                break;
+            case 0x7E: /* ld a, (hl) */
+                cycles += 7;
+                ld(A(), derived().read_memory(HL.p));
+                if(fuse(0x23)) /* inc hl */
+                {
+                    cycles += 6;
+                    HL.p++;
+                    pc++;
+                }
+                pc++; break;
+            case 0x78:
+            case 0x79:
+            case 0x7A:
+            case 0x7B:
+            case 0x7C:
+            case 0x7D:
+            case 0x7F:
+                cycles += 4;
+                ld(A(), get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0x86:
+                cycles += 3;
+            case 0x80:
+            case 0x81:
+            case 0x82:
+            case 0x83:
+            case 0x84:
+            case 0x85:
+            case 0x87:
+                cycles += 4;
+                add(A(), get_register(low_nibble));
+                pc++; break;
+            case 0x8E:
+                cycles += 3;
+            case 0x88:
+            case 0x89:
+            case 0x8A:
+            case 0x8B:
+            case 0x8C:
+            case 0x8D:
+            case 0x8F:
+                cycles += 4;
+                adc(A(), get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0x96:
+                cycles += 3;
+            case 0x90:
+            case 0x91:
+            case 0x92:
+            case 0x93:
+            case 0x94:
+            case 0x95:
+            case 0x97:
+                cycles += 4;
+                sub(get_register(low_nibble));
+                pc++; break;
+            case 0x9E:
+                cycles += 3;
+            case 0x98:
+            case 0x99:
+            case 0x9A:
+            case 0x9B:
+            case 0x9C:
+            case 0x9D:
+            case 0x9F:
+                cycles += 4;
+                sbc(A(), get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0xA6:
+                cycles += 3;
+            case 0xA0:
+            case 0xA1:
+            case 0xA2:
+            case 0xA3:
+            case 0xA4:
+            case 0xA5:
+            case 0xA7:
+                cycles += 4;
+                bitwise_and(get_register(low_nibble));
+                pc++; break;
+            case 0xAE:
+                cycles += 3;
+            case 0xA8:
+            case 0xA9:
+            case 0xAA:
+            case 0xAB:
+            case 0xAC:
+            case 0xAD:
+            case 0xAF:
+                cycles += 4;
+                bitwise_xor(get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0xB6:
+                cycles += 3;
+            case 0xB0:
+            case 0xB1:
+            case 0xB2:
+            case 0xB3:
+            case 0xB4:
+            case 0xB5:
+            case 0xB7:
+                cycles += 4;
+                bitwise_or(get_register(low_nibble));
+                pc++; break;
+            case 0xBE:
+                cycles += 3;
+            case 0xB8:
+            case 0xB9:
+            case 0xBA:
+            case 0xBB:
+            case 0xBC:
+            case 0xBD:
+            case 0xBF:
+                cycles += 4;
+                cp(get_register(low_nibble - 0x8));
+                pc++; break;
+
+            case 0xC0: /* ret nz */
+                if(!(get_flag(6))) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xC1:
+                cycles += 10;
+                pop(BC.p);
+                pc++; break;
+            case 0xC2: /* jp nz, ** */
+                cycles += 10;
+                if(!(get_flag(6)))
+                {
+                    pc = get_operand(2); cover();
+                }
+                else
+                {
+                    pc += 3;
+                }
+                break;
+            case 0xC3: /* jp ** */
+                cycles += 10;
+                pc = get_operand(2); cover();
+                break;
+            case 0xC4: /* call nz, ** */
+                if(!(get_flag(6)))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xC5:
+                cycles += 11;
+                push(BC.p);
+                pc++; break;
+            case 0xC6:
+                cycles += 7;
+                add(A(), get_operand(1));
+                pc += 2; break;
+            case 0xC7:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x00; cover(); break;
+            case 0xC8: /* ret z */
+                if(get_flag(6)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xC9:
+                cycles += 10;
+                pop(pc); cover();
+                break;
+            case 0xCA: /* jp z, ** */
+                cycles += 10;
+                if(get_flag(6))
+                {
+                    pc = get_operand(2); cover();
+                }
+                else
+                {
+                    pc += 3;
+                }
+                break;
+            case 0xCB:
+                pc++; m1++;
+                interpret_bits(derived().fetch(0)); /* Cycle incrementation inside of function */
+                break;
+            case 0xCC: /* call z, ** */
+                if(get_flag(6))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xCD: /* call ** */
+                cycles += 17;
+                push(pc+3);
+                pc = get_operand(2); cover();
+                break;
+            case 0xCE:
+                cycles += 7;
+                add(A(), get_operand(1) + get_flag(0));
+                pc += 2; break;
+            case 0xCF:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x08; cover(); break;
+
+            case 0xD0: /* ret nc */
+                if(!(get_flag(0))) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xD1:
+                cycles += 10;
+                pop(DE.p);
+                pc++; break;
+            case 0xD2: /* jp nc, ** */
+                cycles += 10;
+                if(!(get_flag(0)))
+                {
+                    pc = get_operand(2); cover();
+                }
+                else
+                {
+                    pc += 3;
+                }
+                break;
+            case 0xD3: /* out (*), a */
+                cycles += 11;
+                OUT(get_operand(1), A());
+                pc += 2;break;
+            case 0xD4: /* call nc, ** */
+                if(!(get_flag(0)))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xD5:
+                cycles += 11;
+                push(DE.p);
+                pc++; break;
+            case 0xD6:
+                cycles += 7;
+                sub(get_operand(1));
+                pc += 2; break;
+            case 0xD7:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x10; cover(); break;
+            case 0xD8: /* ret c */
+                if(get_flag(0)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;} 
+                break;
+            case 0xD9:
+                cycles += 4;
+                std::swap(BC.p, BC_.p);
+                std::swap(DE.p, DE_.p);
+                std::swap(HL.p, HL_.p);
+                pc++; break;
+            case 0xDA: /* jp c, * */
+                cycles += 10;
+                if(get_flag(0))
+                {
+                    pc = get_operand(2); cover();
+                }
+                else
+                {
+                    pc += 3;
+                }
+                break;
+            case 0xDB: /* in a, (*) */
+                cycles += 11;
+                IN(A(), get_operand(1));
+                pc += 2; break;
+            case 0xDC: /* call c, * */
+                if(get_flag(0))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xDD:
+                pc++; m1++;
+                interpret_index<&Z80Core::IX>(derived().fetch(0)); /* Cycle incrementation inside of function */
+                break;
+            case 0xDE:
+                cycles += 7;
+                sub(get_operand(1) + get_flag(0));
+                pc += 2; break;
+            case 0xDF:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x18; cover(); break;
+
+            case 0xE0: /* ret po */
+                if(!get_flag(2)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xE1:
+                cycles += 10;
+                pop(HL.p);
+                pc++; break;
+            case 0xE2: /* jp po, ** */
+                cycles += 10;
+                if(!get_flag(2))
+                {
+                    pc = get_operand(2); cover();
+                }
+                else{
+                    pc += 3;
+                }
+                break;
+            case 0xE3: /* ex (sp), hl */
+                cycles += 19;
+                std::swap(L(), derived().get_memory(sp));
+                std::swap(H(), derived().get_memory(sp+1));
+                pc++; break;
+            case 0xE4: /* call po ** */
+                if(!get_flag(2))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xE5:
+                cycles += 11;
+                push(HL.p);
+                pc++; break;
+            case 0xE6:
+                cycles += 7;
+                bitwise_and(get_operand(1));
+                pc += 2; break;
+            case 0xE7: /* rst 20h */
+                cycles += 11;
+                push(pc+1);
+                pc = 0x20; cover(); break;
+            case 0xE8: /* ret pe */
+                if(get_flag(2)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;} 
+                break;
+            case 0xE9: /* jp (hl) */
+                cycles += 4;
+                pc = HL.p; cover();
+                break;
+            case 0xEA: /* jp pe, ** */
+                cycles += 10;
+                if(get_flag(2)) {pc = get_operand(2); cover();}
+                else pc += 3;
+                break;
+            case 0xEB:
+                cycles += 4;
+                std::swap(DE.p, HL.p);
+                pc++; break;
+            case 0xEC:
+                if(get_flag(2))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xED:
+                pc++; m1++;
+                interpret_extd(derived().fetch(0));
+                break;
+            case 0xEE:
+                cycles += 7;
+                bitwise_xor(get_operand(1));
+                pc += 2; break;
+            case 0xEF:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x28; cover(); break;
+
+            case 0xF0:
+                if(!get_flag(7)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xF1:
+                cycles += 10;
+                pop(AF.p);
+                pc++; break;
+            case 0xF2:
+                cycles += 10;
+                if(!get_flag(7)) {pc = get_operand(2); cover();}
+                else
+                    pc += 3;
+                break;
+            case 0xF3: /* di */
+                cycles += 4;
+                di();
+                pc++; break;
+            case 0xF4:
+                if(!get_flag(7))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xF5:
+                cycles += 11;
+                push(AF.p);
+                pc++; break;
+            case 0xF6:
+                cycles += 7;
+                bitwise_or(get_operand(1));
+                pc += 2; break;
+            case 0xF7:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x30; cover(); break;
+            case 0xF8:
+                if(get_flag(7)) {cycles += 11; pop(pc); cover();}
+                else {cycles += 5; pc++;}
+                break;
+            case 0xF9:
+                cycles += 6;
+                ld(sp, HL.p);
+                pc++; break;
+            case 0xFA:
+                cycles += 10;
+                if(get_flag(7)) {pc = get_operand(2); cover();}
+                else
+                    pc += 3;
+                break;
+            case 0xFB: /* ei */
+                cycles += 4;
+                di();
+                pc++; derived().execute(derived().fetch(0)); /* During the execution of this instruction and the following instruction, maskable interrupts are disabled. */
+                ei();
+                break; /* pc was moved by the following instruction */
+            case 0xFC:
+                if(get_flag(7))
+                {
+                    cycles += 17;
+                    push(pc+3);
+                    pc = get_operand(2); cover();
+                }else
+                {
+                    cycles += 10;
+                    pc += 3;
+                }
+                break;
+            case 0xFD:
+                pc++; m1++;
+                interpret_index<&Z80Core::IY>(derived().fetch(0)); /* Cycle incrementation inside of function */
+                break;
+            case 0xFE:
+                cycles += 7;
+                cp(get_operand(1));
+                pc += 2; break;
+            case 0xFF:
+                cycles += 11;
+                push(pc+1);
+                pc = 0x38; cover(); break;
+
+            default:
+                status = Status::Unimplemented;
+                break;
+        }
+
+        if constexpr(Variant::contention)
+            access_time = cycles; /* The next opcode fetch */
+        if(bank_write)
+            update_banks();
+
+        if constexpr(Variant::trace)
+        {
+            /* The opcode tables and the interpreter have to agree, test/decode.cpp checks every opcode */
+            Instruction instruction;
+            if(status == Status::Ok && rom_banks[start >> 14] == (start & 0xC000u) && decode(rom, rom_size, start, instruction)
+               && instruction.flow == Flow::Next && pc != uint16_t(instruction.address + instruction.length) && opcode != 0xFB)
+                std::cout << "Length of " << instruction.text << " differs from the interpreter" << std::endl;
+        }
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::interpret_extd(uint8_t opcode)
+    {
+        uint16_t address;
+
+        switch(opcode)
+        {
+            case 0x40: /* in b, (c) */
+                IN(B(), C());
+                pc++; break;
+            case 0x41:
+                OUT(C(), B());
+                pc++; break;
+            case 0x42:
+                sbc(HL.p, BC.p);
+                pc++; break;
+            case 0x43: /* ld (**), bc */
+                address = get_operand(2);
+                ld(derived().get_memory(address), uint8_t(BC.p & 0xFF));
+                ld(derived().get_memory(address+1), uint8_t(BC.p >> 8));
+                pc += 3; break;
+            case 0x44:
+                A() = twoscomp(A());
+                pc++; break;
+            case 0x45:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x46:
+                interrupt_mode = 0;
+                pc++; break;
+            case 0x47:
+                ld(i, A());
+                pc++; break;
+            case 0x48:
+                IN(C(), C());
+                pc++; break;
+            case 0x49:
+                OUT(C(), C());
+                pc++; break;
+            case 0x4A:
+                adc(HL.p, BC.p);
+                pc++; break;
+            case 0x4B: /* ld bc, (**) */
+                address = get_operand(2);
+                ld(BC.p, derived().read_memory(address) | derived().read_memory(address+1) << 8);
+                pc += 3; break;
+            case 0x4D: /* reti */
+                ei();
+                pop(pc); cover();
+                // Signals I/O device TODO
+                break;
+            case 0x4F:
+                set_refresh(A());
+                pc++; break;
+
+            case 0x50:
+                IN(D(), C());
+                pc++; break;
+            case 0x51:
+                OUT(C(), B());
+                pc++; break;
+            case 0x52:
+                sbc(HL.p, DE.p);
+                pc++; break;
+            case 0x53: /* ld (**), de */
+                address = get_operand(2);
+                ld(derived().get_memory(address), uint8_t(DE.p & 0xFF));
+                ld(derived().get_memory(address+1), uint8_t(DE.p >> 8));
+                pc += 3; break;
+            case 0x55:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x56:
+                interrupt_mode = 1;
+                pc++; break;
+            case 0x57:
+                ld(A(), i);
+                pc++; break;
+            case 0x58:
+                IN(E(), C());
+                pc++; break;
+            case 0x59:
+                OUT(C(), E());
+                pc++; break;
+            case 0x5A:
+                adc(HL.p, DE.p);
+                pc++; break;
+            case 0x5B: /* ld de, (**) */
+                address = get_operand(2);
+                ld(DE.p, derived().read_memory(address) | derived().read_memory(address+1) << 8);
+                pc += 3; break;
+            case 0x5D:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x5E:
+                interrupt_mode = 2;
+                pc++; break;
+            case 0x5F:
+                ld(A(), refresh());
+                pc++; break;
+
+            case 0x60:
+                IN(H(), C());
+                pc++; break;
+            case 0x61:
+                OUT(C(), H());
+                pc++; break;
+            case 0x62:
+                sbc(HL.p, HL.p);
+                pc++; break;
+            case 0x65:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x66:
+                interrupt_mode = 0;
+                pc++; break;
+            case 0x67: /* rrd */
+                rrd();
+                pc++; break;
+            case 0x68:
+                IN(L(), C());
+                pc++; break;
+            case 0x69:
+                OUT(C(), L());
+                pc++; break;
+            case 0x6A:
+                adc(HL.p, HL.p);
+                pc++; break;
+            case 0x6D:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x6F:
+                rld();
+                pc++; break;
+
+            case 0x71: /* out (c), 0 */
+                OUT(C(), Variant::cmos ? 0xFF : 0x00);
+                pc++; break;
+            case 0x72:
+                sbc(HL.p, sp);
+                pc++; break;
+            case 0x73: /* ld (**), sp */
+                address = get_operand(2);
+                ld(derived().get_memory(address), uint8_t(sp & 0xFF));
+                ld(derived().get_memory(address+1), uint8_t(sp >> 8));
+                pc += 3; break;
+            case 0x75:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x76:
+                interrupt_mode = 1;
+                pc++; break;
+            case 0x78:
+                IN(A(), C());
+                pc++; break;
+            case 0x79:
+                OUT(C(), A());
+                pc++; break;
+            case 0x7A:
+                adc(HL.p, sp);
+                pc++; break;
+            case 0x7B: /* ld sp, (**) */
+                address = get_operand(2);
+                ld(sp, derived().read_memory(address) | derived().read_memory(address+1) << 8);
+                pc += 3; break;
+            case 0x7D:
+                pop(pc); cover();
+                iff1 = iff2;
+                break;
+            case 0x7E:
+                interrupt_mode = 2;
+                pc++; break;
+
+            case 0xA0:
+                ldi();
+                pc++; break;
+            case 0xA1:
+                cpi();
+                pc++; break;
+            case 0xA2:
+                ini();
+                pc++; break;
+            case 0xA3:
+                outi();
+                pc++; break;
+            case 0xA8:
+                ldd();
+                pc++; break;
+            case 0xA9:
+                cpd();
+                pc++; break;
+            case 0xAA:
+                ind();
+                pc++; break;
+            case 0xAB:
+                outd();
+                pc++; break;
+
+            case 0xB0:
+                ldir();
+                pc++; break;
+            case 0xB1:
+                cpir();
+                pc++; break;
+            case 0xB2:
+                inir();
+                pc++; break;
+            case 0xB3:
+                otir();
+                pc++; break;
+            case 0xB8:
+                lddr();
+                pc++; break;
+            case 0xB9:
+                cpdr();
+                pc++; break;
+            case 0xBA:
+                indr();
+                pc++; break;
+            case 0xBB:
+                otdr();
+                pc++; break;
+
+            default:
+                pc--; /* Back on the prefix */
+                status = Status::Unimplemented;
+                break;
+        }
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::interpret_bits(uint8_t opcode)
+    {
+        uint8_t* registers[] = {&B(), &C(), &D(), &E(), &H(), &L(), nullptr, &A()};
+        uint8_t value;
+
+        if((opcode & 0x7) == 0x6 && (opcode & 0xC0) == 0x40) /* bit only reads (hl) */
+        {
+            value = derived().read_memory(HL.p);
+            registers[6] = &value;
+            cycles += 12;
+        }
+        else if((opcode & 0x7) == 0x6) /* (hl) is only accessed when the instruction uses it */
+        {
+            registers[6] = &derived().get_memory(HL.p);
+            cycles += 15;
+        }
+        else
+            cycles += 8;
+        if(bit_operation(opcode, registers[opcode & 0x7]))
+            pc++;
+        else
+            pc--; /* Back on the prefix */
+    }
+
+    /* Second byte of the CB instructions, shared with DDCB and FDCB */
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::bit_operation(uint8_t opcode, uint8_t* m)
+    {
+        uint8_t b = opcode >> 3 & 0x7;
+
+        switch(opcode >> 6)
+        {
+            case 0x0:
+                switch(b)
+                {
+                    case 0x0: rlc(m); break;
+                    case 0x1: rrc(m); break;
+                    case 0x2: rl(m); break;
+                    case 0x3: rr(m); break;
+                    case 0x4: sla(m); break;
+                    case 0x5: sra(m); break;
+                    case 0x6:
+                        if constexpr(!Variant::undocumented_opcodes)
+                        {
+                            status = Status::Unimplemented;
+                            return false;
+                        }
+                        sll(m); break;
+                    case 0x7: srl(m); break;
+                }
+                break;
+            case 0x1:
+                bit(b, m); break;
+            case 0x2:
+                res(b, m); break;
+            case 0x3:
+                set(b, m); break;
+        }
+        return true;
+    }
+
+    /* DD and FD prefixes, Index is IX or IY. pc is on the byte following the prefix. */
+    template <class Derived, class Variant>
+    template <Register Z80Core<Derived, Variant>::*Index>
+    void Z80Core<Derived, Variant>::interpret_index(uint8_t opcode)
+    {
+        Register& xy = this->*Index;
+        uint8_t dst = opcode >> 3 & 0x7;
+        uint8_t src = opcode & 0x7;
+        uint16_t address;
+
+        switch(opcode)
+        {
+            case 0x09: /* add ix, bc */
+                cycles += 15;
+                add(xy.p, BC.p);
+                pc++; break;
+            case 0x19: /* add ix, de */
+                cycles += 15;
+                add(xy.p, DE.p);
+                pc++; break;
+            case 0x21: /* ld ix, ** */
+                cycles += 14;
+                ld(xy.p, get_operand(2));
+                pc += 3; break;
+            case 0x22: /* ld (**), ix */
+                cycles += 20;
+                address = get_operand(2);
+                ld(derived().get_memory(address), xy.lo());
+                ld(derived().get_memory(address+1), xy.hi());
+                pc += 3; break;
+            case 0x23: /* inc ix */
+                cycles += 10;
+                inc(xy.p);
+                pc++; break;
+            case 0x29: /* add ix, ix */
+                cycles += 15;
+                add(xy.p, xy.p);
+                pc++; break;
+            case 0x2A: /* ld ix, (**) */
+                cycles += 20;
+                address = get_operand(2);
+                ld(xy.lo(), derived().read_memory(address));
+                ld(xy.hi(), derived().read_memory(address+1));
+                pc += 3; break;
+            case 0x2B: /* dec ix */
+                cycles += 10;
+                dec(xy.p);
+                pc++; break;
+            case 0x34: /* inc (ix+*) */
+                cycles += 23;
+                inc(derived().get_memory(xy.p + static_cast<int8_t>(derived().fetch(1))));
+                pc += 2; break;
+            case 0x35: /* dec (ix+*) */
+                cycles += 23;
+                dec(derived().get_memory(xy.p + static_cast<int8_t>(derived().fetch(1))));
+                pc += 2; break;
+            case 0x36: /* ld (ix+*), * */
+                cycles += 19;
+                ld(derived().get_memory(xy.p + static_cast<int8_t>(derived().fetch(1))), derived().fetch(2));
+                pc += 3; break;
+            case 0x39: /* add ix, sp */
+                cycles += 15;
+                add(xy.p, sp);
+                pc++; break;
+            case 0xCB: /* ix bits, the last opcode byte is read without an M1 cycle */
+                address = xy.p + static_cast<int8_t>(derived().fetch(1));
+                opcode = derived().fetch(2);
+                cycles += (opcode & 0xC0) == 0x40 ? 20 : 23;
+                interpret_index_bits<Index>(opcode, address);
+                break;
+            case 0xE1: /* pop ix */
+                cycles += 14;
+                pop(xy.p);
+                pc++; break;
+            case 0xE3: /* ex (sp), ix */
+                cycles += 23;
+                std::swap(xy.lo(), derived().get_memory(sp));
+                std::swap(xy.hi(), derived().get_memory(sp+1));
+                pc++; break;
+            case 0xE5: /* push ix */
+                cycles += 15;
+                push(xy.p);
+                pc++; break;
+            case 0xE9: /* jp (ix) */
+                cycles += 8;
+                pc = xy.p; cover();
+                break;
+            case 0xF9: /* ld sp, ix */
+                cycles += 10;
+                ld(sp, xy.p);
+                pc++; break;
+
+            /* Undocumented forms using the halves of the index register */
+            case 0x24: /* inc ixh */
+            case 0x25: /* dec ixh */
+            case 0x26: /* ld ixh, * */
+            case 0x2C: /* inc ixl */
+            case 0x2D: /* dec ixl */
+            case 0x2E: /* ld ixl, * */
+                if constexpr(!Variant::undocumented_opcodes)
+                {
+                    pc--; /* Back on the prefix */
+                    status = Status::Unimplemented;
+                    break;
+                }
+                if(src == 0x4)
+                {
+                    cycles += 8;
+                    inc(index_register<Index>(dst));
+                    pc++; break;
+                }
+                if(src == 0x5)
+                {
+                    cycles += 8;
+                    dec(index_register<Index>(dst));
+                    pc++; break;
+                }
+                cycles += 11;
+                ld(index_register<Index>(dst), derived().fetch(1));
+                pc += 2; break;
+
+            default:
+                if(opcode >= 0x40 && opcode < 0xC0 && opcode != 0x76)
+                {
+                    if(src == 0x6 || (opcode < 0x80 && dst == 0x6)) /* (ix+*), the other operand is a plain register */
+                    {
+                        cycles += 19;
+                        address = xy.p + static_cast<int8_t>(derived().fetch(1));
+                        if(opcode >= 0x80)
+                            alu(dst, derived().read_memory(address));
+                        else if(src == 0x6)
+                            ld(*register_operand(dst), derived().read_memory(address));
+                        else
+                            ld(derived().get_memory(address), *register_operand(src));
+                        pc += 2; break;
+                    }
+                    if(src == 0x4 || src == 0x5 || (opcode < 0x80 && (dst == 0x4 || dst == 0x5)))
+                    {
+                        if constexpr(!Variant::undocumented_opcodes)
+                        {
+                            pc--; /* Back on the prefix */
+                            status = Status::Unimplemented;
+                            break;
+                        }
+                        cycles += 8;
+                        if(opcode >= 0x80)
+                            alu(dst, index_register<Index>(src));
+                        else
+                            ld(index_register<Index>(dst), index_register<Index>(src));
+                        pc++; break;
+                    }
+                }
+
+                /* The prefix does not apply, the instruction runs as usual */
+                cycles += 4;
+                m1--; /* Counted again by execute() */
+                if constexpr(Variant::metrics)
+                    metrics.instructions.sub(1);
+                derived().execute(opcode);
+                break;
+        }
+    }
+
+    /* DDCB and FDCB, the result of the undocumented forms is copied to a register */
+    template <class Derived, class Variant>
+    template <Register Z80Core<Derived, Variant>::*Index>
+    void Z80Core<Derived, Variant>::interpret_index_bits(uint8_t opcode, uint16_t address)
+    {
+        uint8_t src = opcode & 0x7;
+        uint8_t value = derived().read_memory(address);
+
+        if constexpr(!Variant::undocumented_opcodes)
+        {
+            if(src != 0x6)
+            {
+                pc--; /* Back on the prefix */
+                status = Status::Unimplemented;
+                return;
+            }
+        }
+
+        if(!bit_operation(opcode, &value))
+        {
+            pc--;
+            return;
+        }
+        if((opcode & 0xC0) != 0x40) /* bit only reads */
+        {
+            derived().get_memory(address) = value;
+            if(src != 0x6)
+                *register_operand(src) = value;
+        }
+        pc += 3;
+    }
+
+    /* H and L stand for the halves of the index register */
+    template <class Derived, class Variant>
+    template <Register Z80Core<Derived, Variant>::*Index>
+    uint8_t& Z80Core<Derived, Variant>::index_register(uint8_t index)
+    {
+        if(index == 0x4)
+            return (this->*Index).hi();
+        if(index == 0x5)
+            return (this->*Index).lo();
+        return *register_operand(index);
+    }
+
+    template <class Derived, class Variant>
+    uint8_t Z80Core<Derived, Variant>::fetch(int offset)
+    {
+        derived().contend(pc+offset);
+        if constexpr(Variant::contention)
+        {
+            if(offset == 0)
+                access_time++; /* An opcode fetch is four T-states long, other reads three */
+        }
+        return rom_byte(pc+offset);
+    }
+
+    /* Superinstructions, the pairs come from the opcode pair counts of variant::Profile
+     * as printed by tools/pairs.
+     * The second opcode is only looked at inside run(), so single steps and
+     * breakpoints always see every instruction. */
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::fuse(uint8_t next)
+    {
+        if constexpr(Variant::superinstructions && !Variant::trace)
+        {
+            if(fusing && derived().fetch(1) == next)
+            {
+                m1++;
+                if constexpr(Variant::metrics)
+                    metrics.instructions.add(1);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /* Same scheme as AFL: the edge is the current location xored with the
+     * previous one shifted, so that A -> B and B -> A are different edges */
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cover()
+    {
+        if constexpr(Variant::coverage)
+        {
+            uint16_t location = pc * 40503u; /* Spreads nearby addresses over the map */
+
+            if(coverage_map)
+                coverage_map[location ^ prev_location]++;
+            prev_location = location >> 1;
+        }
+    }
+
+    template <class Derived, class Variant>
+    Status Z80Core<Derived, Variant>::step()
+    {
+        unsigned int frame_cycles = cpu_frequency/refresh_rate; /* Number of cycles for one frame */
+        Pacer::clock::time_point start = Pacer::clock::now();
+
+        clock_base += cycles;
+        cycles = 0;
+        access_time = 0;
+        Status result = derived().run(frame_cycles);
+        if(result == Status::Halted)
+        {
+            if(cycles < frame_cycles)
+            {
+                metrics.halt_t_states.add(frame_cycles - cycles);
+                metrics.t_states.add(frame_cycles - cycles);
+            }
+            cycles = frame_cycles; /* Nothing happens until the next interrupt */
+            result = Status::BudgetExhausted;
+        }
+        derived().end_frame();
+
+        uint64_t host_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Pacer::clock::now() - start).count();
+        metrics.frames.add(1);
+        metrics.frame_ns.set(host_ns);
+        metrics.host_ns.add(host_ns);
+        if(refresh_rate != paced_rate) /* The host changed the frame rate */
+        {
+            paced_rate = refresh_rate;
+            pacer.set_period(std::chrono::nanoseconds(1000000000 / refresh_rate));
+        }
+        pacer.wait();
+        return result;
+    }
+
+    template <class Derived, class Variant>
+    Status Z80Core<Derived, Variant>::run(unsigned int budget)
+    {
+        unsigned int start = cycles;
+        bool resuming = status == Status::Breakpoint; /* pc is on the breakpoint run() stopped on last */
+
+        status = Status::Ok;
+        if(breakpoint_count == 0)
+        {
+            bool replay = journal && journal->get_mode() == Journal::Mode::Replay;
+            bool can_fuse = true;
+            if constexpr(Variant::contention)
+                can_fuse = contention_length == 0; /* A fused fetch would be contended too early */
+            while(status == Status::Ok && cycles - start < budget)
+            {
+                /* A profiler's flag is looked at every few hundred T-states rather than before every instruction */
+                unsigned int limit = budget;
+                if(profiler)
+                {
+                    if(profiler->due())
+                        sample();
+                    limit = std::min(budget, cycles - start + 256);
+                }
+
+                /* A replay runs at full speed up to the boundary its next interrupt was
+                 * recorded on, the first one at or past its time. A fused pair could
+                 * step over that boundary, so the last few T-states before it are run
+                 * without fusion. */
+                fusing = can_fuse;
+                if(replay)
+                {
+                    const uint64_t UNFUSED = 32; /* More than the first instruction of any fused pair */
+
+                    replay_interrupts();
+                    uint64_t left = journal->next_interrupt() - (elapsed() - journal_start);
+                    if(left > UNFUSED)
+                        left -= UNFUSED;
+                    else
+                        fusing = false;
+                    if(left < limit - (cycles - start))
+                        limit = cycles - start + left;
+                }
+
+                while(status == Status::Ok && cycles - start < limit)
+                    derived().execute(derived().fetch(0));
+            }
+            fusing = false;
+        }
+        else
+        {
+            while(status == Status::Ok && cycles - start < budget)
+            {
+                replay_interrupts();
+                if(breakpoints[pc] && !resuming)
+                {
+                    status = Status::Breakpoint;
+                    break;
+                }
+                resuming = false;
+                if(profiler && profiler->due())
+                    sample();
+                derived().execute(derived().fetch(0));
+            }
+        }
+
+        metrics.t_states.add(cycles - start); /* Not elapsed(), which goes back with a loaded state */
+        return status == Status::Ok ? Status::BudgetExhausted : status;
+    }
+
+    /* A stack word is taken for a return address when it follows a call or a restart */
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::sample()
+    {
+        Sample taken;
+
+        taken.pc = pc;
+        taken.sp = sp;
+        taken.depth = 0;
+        for(unsigned int n = 0; n<2*Sample::MAX_DEPTH && taken.depth < Sample::MAX_DEPTH; ++n)
+        {
+            uint16_t address = memory[uint16_t(sp + 2*n)] | memory[uint16_t(sp + 2*n + 1)] << 8;
+            uint8_t call = rom_byte(address - 3);
+            uint8_t* restart = rom_location(address - 1); /* Not rom_byte(), past the image reads as rst 38h */
+            if(call == 0xCD || (call & 0xC7) == 0xC4 || (restart && (*restart & 0xC7) == 0xC7))
+                taken.returns[taken.depth++] = address;
+        }
+        profiler->record(taken);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_breakpoint(uint16_t address, bool value)
+    {
+        if(breakpoints[address] != value)
+            breakpoint_count += value ? 1 : -1;
+        breakpoints[address] = value;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::clear_breakpoints()
+    {
+        breakpoints.reset();
+        breakpoint_count = 0;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::interrupt()
+    {
+        if(journal)
+        {
+            if(journal->get_mode() == Journal::Mode::Replay)
+                return;
+            journal->record_interrupt(elapsed() - journal_start);
+        }
+        accept_interrupt();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::accept_interrupt()
+    {
+        metrics.interrupts.add(1);
+        if(pins[17]) /* Leaves halt */
+        {
+            pins[17] = false;
+            pc++;
+        }
+    }
+
+    /* Interrupts of a replay are taken on the instruction boundary they were recorded on */
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::replay_interrupts()
+    {
+        while(journal && journal->interrupt_due(elapsed() - journal_start))
+            accept_interrupt();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_journal(Journal* journal)
+    {
+        this->journal = journal;
+        journal_start = elapsed();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ei()
+    {
+        iff1 = true;
+        iff2 = true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::di()
+    {
+        iff1 = false;
+        iff2 = false;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::sub(unsigned int src)
+    {
+        arithmetic_sub(A(), src);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::bitwise_and(unsigned int src)
+    {
+        unsigned int result = A() & src;
+
+        set_CF(false);
+        set_NF(false);
+        set_POF(parity_check(result));
+        set_HF(true);
+        set_ZF((result & 0xFF) == 0);
+        set_SF(result & 0x80);
+
+        A() = result;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::bitwise_xor(unsigned int src)
+    {
+        unsigned int result = A() ^ src;
+
+        set_CF(false);
+        set_NF(false);
+        set_POF(parity_check(result));
+        set_HF(false);
+        set_ZF((result & 0xFF) == 0);
+        set_SF(result & 0x80);
+
+        A() = result;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::bitwise_or(unsigned int src)
+    {
+        unsigned int result = A() | src;
+        set_CF(false);
+        set_NF(false);
+        set_POF(parity_check(result));
+        set_HF(false);
+        set_ZF((result & 0xFF) == 0);
+        set_SF(result & 0x80);
+
+        A() = result;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cp(unsigned int src)
+    {
+        unsigned int result = A() - src;
+        unsigned int half_result = (A() & 0xF) - (src & 0xF);
+
+        set_CF(result > 255);
+        set_NF(true);
+        set_POF(twoscomp(result) > 255);
+        set_F3(0x1 << 3 & result);
+        set_HF(half_result & 0x10);
+        set_F5(0x1 << 5 & result);
+        set_ZF((result & 0xFF) == 0);
+        set_SF(result & 0x80);
+
+    }
+
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::parity_check(unsigned int bin)
+    {
+        unsigned int c = 0;
+        for(unsigned int i = 0; i<sizeof(bin)*8; ++i)
+        {
+            c += bin << i & 0x1;
+        }
+
+        return !(c % 2);
+    }
+
+    template <class Derived, class Variant>
+    uint16_t Z80Core<Derived, Variant>::get_operand(int offset)
+    {
+        if (offset == 1)
+        {
+            return derived().fetch(1);
+        }
+        return derived().fetch(2) << 8 | derived().fetch(1);
+    }
+
+    template <class Derived, class Variant>
+    uint8_t& Z80Core<Derived, Variant>::get_memory(uint16_t address)
+    {
+        derived().contend(address);
+        mark_dirty(address);
+        if(bank_register_slots)
+            bank_write = true;
+        return memory[address];
+    }
+
+    template <class Derived, class Variant>
+    uint8_t Z80Core<Derived, Variant>::read_memory(uint16_t address)
+    {
+        derived().contend(address);
+        return memory[address];
+    }
+
+    template <class Derived, class Variant>
+    uint8_t* Z80Core<Derived, Variant>::register_operand(uint8_t index)
+    {
+        switch(index)
+        {
+            case 0: return &B();
+            case 1: return &C();
+            case 2: return &D();
+            case 3: return &E();
+            case 4: return &H();
+            case 5: return &L();
+        }
+        return &A();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::alu(uint8_t operation, unsigned int value)
+    {
+        switch(operation)
+        {
+            case 0: add(A(), value); break;
+            case 1: adc(A(), value); break;
+            case 2: sub(value); break;
+            case 3: sbc(A(), value); break;
+            case 4: bitwise_and(value); break;
+            case 5: bitwise_xor(value); break;
+            case 6: bitwise_or(value); break;
+            case 7: cp(value); break;
+        }
+    }
+
+    template <class Derived, class Variant>
+    uint8_t Z80Core<Derived, Variant>::get_register(uint8_t index)
+    {
+        switch(index)
+        {
+            case 0: return B();
+            case 1: return C();
+            case 2: return D();
+            case 3: return E();
+            case 4: return H();
+            case 5: return L();
+            case 6: return derived().read_memory(HL.p);
+        }
+        return A();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::contend(uint16_t address)
+    {
+        if constexpr(Variant::contention)
+        {
+            /* Only accesses to contended pages look up the delay, taken at the T-state of the access.
+             * Instructions add their length up front, access_time follows them through their bus cycles. */
+            if(contended[address >> 8] && access_time < contention_length)
+            {
+                unsigned int delay = contention_delays[access_time];
+                cycles += delay;
+                access_time += delay;
+            }
+            access_time += 3;
+        }
+    }
+
+    template <class Derived, class Variant>
+    uint8_t Z80Core<Derived, Variant>::input(uint8_t port)
+    {
+        uint8_t value;
+
+        metrics.port_reads.add(1);
+        if(!journal)
+            return derived().port_in(port);
+
+        if(journal->get_mode() == Journal::Mode::Replay && journal->replay_port(elapsed() - journal_start, port, value))
+            return value;
+        value = derived().port_in(port);
+        if(journal->get_mode() == Journal::Mode::Record)
+            journal->record_port(elapsed() - journal_start, port, value);
+        return value;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::output(uint8_t port, uint8_t value)
+    {
+        metrics.port_writes.add(1);
+        if(bank_ports[port] >= 0)
+            map_bank(bank_ports[port], value);
+        derived().port_out(port, value);
+    }
+
+    template <class Derived, class Variant>
+    uint8_t Z80Core<Derived, Variant>::port_in(uint8_t port)
+    {
+        return ports[port];
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::port_out(uint8_t port, uint8_t value)
+    {
+        ports[port] = value;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::end_frame()
+    {
+        if(frame_export)
+            frame_export->publish(memory);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::save_state(State& state)
+    {
+        state.af = AF.p; state.bc = BC.p; state.de = DE.p; state.hl = HL.p;
+        state.af_ = AF_.p; state.bc_ = BC_.p; state.de_ = DE_.p; state.hl_ = HL_.p;
+        state.ix = IX.p; state.iy = IY.p; state.sp = sp; state.pc = pc;
+        state.i = i; state.r = refresh();
+        state.iff1 = iff1; state.iff2 = iff2;
+        state.interrupt_mode = interrupt_mode;
+        state.halted = pins[17];
+        state.reserved = 0;
+        for(unsigned int slot = 0; slot<4; ++slot)
+            state.banks[slot] = rom_banks[slot] >> 14;
+        state.cycles = cycles;
+        memcpy(state.ports, ports, sizeof(ports));
+        memcpy(state.memory, memory, sizeof(memory));
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::load_state(const State& state)
+    {
+        load_registers(state);
+        memcpy(ports, state.ports, sizeof(ports));
+        memcpy(memory, state.memory, sizeof(memory));
+        memset(dirty_pages, 0xFF, sizeof(dirty_pages)); /* A snapshot taken before no longer matches any page */
+        memset(written_pages, 0xFF, sizeof(written_pages));
+        latch_bank_registers();
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::load_registers(const State& state)
+    {
+        AF.p = state.af; BC.p = state.bc; DE.p = state.de; HL.p = state.hl;
+        AF_.p = state.af_; BC_.p = state.bc_; DE_.p = state.de_; HL_.p = state.hl_;
+        IX.p = state.ix; IY.p = state.iy; sp = state.sp; pc = state.pc;
+        i = state.i; set_refresh(state.r);
+        iff1 = state.iff1; iff2 = state.iff2;
+        interrupt_mode = state.interrupt_mode;
+        pins[17] = state.halted;
+        for(unsigned int slot = 0; slot<4; ++slot)
+        {
+            rom_banks[slot] = state.banks[slot] << 14;
+            if(rom_banks[slot] != slot << 14)
+                banked = true;
+        }
+        cycles = state.cycles;
+        access_time = cycles;
+        status = Status::Ok;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::snapshot(State& state)
+    {
+        save_state(state);
+        memset(dirty_pages, 0, sizeof(dirty_pages));
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::restore(const State& state)
+    {
+        load_registers(state);
+        memcpy(ports, state.ports, sizeof(ports));
+        prev_location = 0; /* Each run starts a new path for the coverage map */
+
+        for(unsigned int word = 0; word<4; ++word)
+        {
+            for(uint64_t bits = dirty_pages[word]; bits; bits &= bits - 1)
+            {
+                unsigned int page = word << 6 | __builtin_ctzll(bits);
+                memcpy(memory + (page << 8), state.memory + (page << 8), 256);
+            }
+            written_pages[word] |= dirty_pages[word]; /* Changed back, which the host has to see too */
+            dirty_pages[word] = 0;
+        }
+        latch_bank_registers();
+    }
+
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::save_state(const char* filename, bool compress)
+    {
+        State* state = new State;
+
+        save_state(*state);
+        bool ok = write_state(filename, *state, compress);
+        delete state;
+        return ok;
+    }
+
+    template <class Derived, class Variant>
+    bool Z80Core<Derived, Variant>::load_state(const char* filename)
+    {
+        StateFile file(filename);
+
+        if(!file.get())
+            return false;
+        load_state(*file.get());
+        return true;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_contended(uint16_t start, uint16_t end, bool value)
+    {
+        for(unsigned int page = start >> 8; page <= (unsigned int)(end >> 8); ++page)
+            contended[page] = value;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_contention_table(const uint8_t* delays, unsigned int length)
+    {
+        contention_delays = delays;
+        contention_length = length;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rlca()
+    {
+        uint8_t msb = A() & 0x80;
+        A() = (A() << 1) | (msb >> 7);
+        set_CF(bool(msb >> 7));
+
+        set_HF(false);
+        set_NF(false);
+        
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rla()
+    {
+        uint8_t carry_flag = F() & 0x01;
+        rlca();
+        A() &= 0xFE; /* reset bit 0 */
+        A() |= carry_flag;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rrca()
+    {
+        uint8_t lsb = 0x01 & A();
+        A() = (A() >> 1) | (lsb << 7);
+        set_CF(bool(lsb));
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rra()
+    {
+        uint8_t carry_flag = F() & 0x01;
+        rrca();
+        A() &= 0x7F; /* reset bit 7 */
+        A() |= carry_flag << 7;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::djnz(int value)
+    {
+        cycles += 8;
+        dec(B());
+        if(B() != 0)
+        {
+            cycles += 5;
+            pc += value + 2;
+            cover();
+        }
+        else
+            pc += 2;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cpl()
+    {
+        for(int i = 0; i<8; ++i)
+        {
+            uint8_t b = 0x1 << i;
+            if(A() & b)
+                A() &= 0xFF - b; /* change 1 to 0 */
+            else
+                A() |= b; /* change 0 to 1 */
+        }
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::daa()
+    {
+        /* Code from x86 DAA operation */
+        uint8_t old_A = A();
+        uint8_t old_CF = get_flag(0);
+        set_CF(false);
+
+        if((A() & 0xF) > 9 || get_flag(4) == 1)
+        {
+            add(A(), A()+6);
+            set_CF(old_CF || get_flag(0));
+            set_HF(true);
+        }else
+            set_HF(false);
+
+        if(old_A > 0x99 || old_CF == 1)
+        {
+            add(A(), A()+0x60);
+            set_CF(true);
+        }else
+            set_CF(false);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rrd()
+    {
+        uint8_t low_nibble = A() & 0xF;
+
+        uint8_t& m = derived().get_memory(HL.p);
+
+        A() = (A() & 0xF0) | (m & 0x0F);
+        m = (m >> 4) | (low_nibble << 4);
+
+        set_SF(A() & 0x80);
+        set_ZF(A() == 0);
+        set_HF(false);
+        set_POF(parity_check(A()));
+        set_NF(false);
+        /* Carry flag is not affected */
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rld()
+    {
+        uint8_t& m = derived().get_memory(HL.p);
+        uint8_t high_nibble = m >> 4;
+        uint8_t low_nibble = A() & 0x0F;
+
+        m = (m & 0x0F) | ((m & 0x0F) << 4);
+        A() = (A() & 0xF0) | high_nibble;
+        m = (m & 0xF0) | low_nibble;
+
+        set_SF(A() & 0x80);
+        set_ZF(A() == 0);
+        set_HF(false);
+        set_POF(parity_check(A()));
+        set_NF(false);
+        /* Carry flag is not affected */
+
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ldi()
+    {
+        ld(derived().get_memory(DE.p), derived().read_memory(HL.p));
+        metrics.block_bytes.add(1);
+        DE.p++;
+        HL.p++;
+        BC.p--;
+
+        set_HF(false);
+        set_POF(BC.p - 1 != 0);
+        set_NF(false);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cpi()
+    {
+        uint8_t value = derived().read_memory(HL.p);
+        unsigned int result = A() - value;
+        unsigned int half_result = (A()&0x0F) - (value&0x0F);
+
+
+        set_SF(result & 0x80);
+        set_ZF((result&0xFF) == 0);
+        set_HF(half_result&0x10);
+        set_POF(BC.p - 1 != 0);
+        set_NF(true);
+
+        BC.p--;
+        HL.p++;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ini()
+    {
+        derived().get_memory(HL.p) = input(C());
+        metrics.block_bytes.add(1);
+
+        set_ZF(B() - 1 == 0);
+        set_NF(true);
+
+        (B())--;
+        HL.p++;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::outi()
+    {
+        output(C(), derived().read_memory(HL.p));
+        metrics.block_bytes.add(1);
+
+        set_ZF(B() - 1 == 0);
+        set_NF(true);
+
+        (B())--;
+        HL.p++;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ldd()
+    {
+        derived().get_memory(DE.p) = derived().read_memory(HL.p);
+        metrics.block_bytes.add(1);
+
+        set_HF(false);
+        set_POF(BC.p - 1 != 0);
+        set_NF(false);
+
+        HL.p--;
+        DE.p--;
+        BC.p--; /* Byte counter */
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cpd()
+    {
+        unsigned int result = A() - derived().read_memory(HL.p);
+        unsigned int half_result = (A()&0x0F) - (HL.p&0x0F);
+
+        set_SF(result & 0x80);
+        set_ZF(result == 0);
+        set_HF(half_result&0x10);
+        set_POF(BC.p - 1 != 0);
+        set_NF(true);
+
+        HL.p--;
+        BC.p--;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ind()
+    {
+        derived().get_memory(HL.p) = input(C());
+        metrics.block_bytes.add(1);
+
+        set_ZF(B() - 1 == 0);
+        set_NF(true);
+
+        (B())++;
+        HL.p--;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::outd()
+    {
+        output(C(), derived().read_memory(HL.p));
+        metrics.block_bytes.add(1);
+
+        set_ZF(B() - 1 == 0);
+        set_NF(true);
+
+        (B())--;
+        HL.p--;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::ldir()
+    {
+        do
+        {
+            ldi();
+        }while(BC.p != 0);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cpir()
+    {
+        do
+        {
+            cpi();
+        }while(BC.p != 0 || A() != derived().read_memory(HL.p));
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::inir()
+    {
+        do
+        {
+            ini();
+        } while(B() != 0);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::otir()
+    {
+        do
+        {
+            outd();
+        } while(B() != 0);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::lddr()
+    {
+        do
+        {
+            ldd();
+        }while(BC.p != 0);
+        set_POF(false);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::cpdr()
+    {
+        do
+        {
+            cpd();
+        } while(BC.p != 0 || A() != derived().read_memory(HL.p));
+        /* La documentation n'est pas claire, on ne sait pas si c'est un or ou un and pour la condition */
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::indr()
+    {
+        do
+        {
+            ind();
+        } while(B() != 0);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::otdr()
+    {
+        do
+        {
+            outd();
+        } while(B() != 0);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rlc(uint8_t* m)
+    {
+        set_CF(*m & 0x80);
+        rl(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rrc(uint8_t* m)
+    {
+        set_CF(0x01 & *m);
+        rr(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rl(uint8_t* m)
+    {
+        uint8_t msb = *m & 0x80;
+        *m = (*m << 1) | (get_flag(0));
+        set_CF(msb);
+
+        set_SF(*m & 0x80);
+        set_ZF(*m == 0);
+        set_HF(false);
+        set_POF(parity_check(*m));
+        set_NF(false);
+
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::rr(uint8_t* m)
+    {
+        uint8_t lsb = 0x01 & *m;
+        *m = (*m >> 1) | (get_flag(0) << 7);
+        set_CF(lsb);
+
+        set_SF(*m & 0x80);
+        set_ZF(*m == 0);
+        set_HF(false);
+        set_POF(parity_check(*m));
+        set_NF(false);
+
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::sla(uint8_t* m)
+    {
+        set_CF(0);
+        rl(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::sra(uint8_t* m)
+    {
+        set_CF(1);
+        rr(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::srl(uint8_t* m)
+    {
+        set_CF(0);
+        rr(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::sll(uint8_t* m)
+    {
+        set_CF(1);
+        rl(m);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::bit(uint8_t b, uint8_t* m)
+    {
+        set_ZF(!(*m & (0x1 << b)));
+        set_HF(true);
+        set_NF(false);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::res(uint8_t b, uint8_t* m)
+    {
+        *m &= ~(0x1 << b);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set(uint8_t b, uint8_t* m)
+    {
+        *m |= (0x1 << b);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::pop(uint16_t& dst)
+    {
+       dst = derived().read_memory(sp+1) << 8 | derived().read_memory(sp); /* Low byte on top of the stack */
+       sp += 2;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::push(uint16_t src)
+    {
+        derived().get_memory(sp-1) = src >> 8;
+        derived().get_memory(sp-2) = src & 0xFF;
+        sp -= 2;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_flag(uint8_t flag, bool value)
+    {
+        F() &= 0x1 << flag ^ 0xFF; /* reset le flag en question */
+        F() |= value << flag;
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_CF(bool value)
+    {
+        set_flag(0, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_NF(bool value)
+    {
+        set_flag(1, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_POF(bool value)
+    {
+        set_flag(2, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_F3(bool value)
+    {
+        if constexpr(Variant::undocumented_flags)
+            set_flag(3, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_HF(bool value)
+    {
+        set_flag(4, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_F5(bool value)
+    {
+        if constexpr(Variant::undocumented_flags)
+            set_flag(5, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_ZF(bool value)
+    {
+        set_flag(6, value);
+    }
+
+    template <class Derived, class Variant>
+    void Z80Core<Derived, Variant>::set_SF(bool value)
+    {
+        set_flag(7, value);
+    }
+
+    template <class Derived, class Variant>
+    unsigned int Z80Core<Derived, Variant>::get_flag(unsigned int flag)
+    {
+        return F() >> flag & 0x1;
+    }
+
+    template <class Derived, class Variant>
     template <class T, class U>
-    void Z80::ld(T& dst, U src)
+    void Z80Core<Derived, Variant>::ld(T& dst, U src)
     {
         dst = src;
     }
 
+    template <class Derived, class Variant>
     template <class T, class U>
-    void Z80::add(T& dst, U src)
+    void Z80Core<Derived, Variant>::add(T& dst, U src)
     {
         if(sizeof(T) == 2)
         {
@@ -38,8 +2654,9 @@ namespace Z80
         dst = result;
     }
 
+    template <class Derived, class Variant>
     template <class T>
-    void Z80::inc(T& dst)
+    void Z80Core<Derived, Variant>::inc(T& dst)
     {
         if(sizeof(T) == 2)
         {
@@ -49,8 +2666,9 @@ namespace Z80
         add(dst, 1);
     }
 
+    template <class Derived, class Variant>
     template <class T, class U>
-    void Z80::adc(T& dst, U src)
+    void Z80Core<Derived, Variant>::adc(T& dst, U src)
     {
         add(dst, src+get_flag(0));
         if(sizeof(T) == 2)
@@ -61,8 +2679,9 @@ namespace Z80
         }
     }
 
+    template <class Derived, class Variant>
     template <class T, class U>
-    void Z80::arithmetic_sub(T& dst, U src)
+    void Z80Core<Derived, Variant>::arithmetic_sub(T& dst, U src)
     {
         unsigned int result = dst - src;
         if(sizeof(T) == 2)
@@ -84,8 +2703,9 @@ namespace Z80
         dst = result;
     }
 
+    template <class Derived, class Variant>
     template <class T>
-    void Z80::dec(T& dst)
+    void Z80Core<Derived, Variant>::dec(T& dst)
     {
         if(sizeof(T) == 2)
         {
@@ -95,14 +2715,16 @@ namespace Z80
         arithmetic_sub(dst, 1);
     }
 
+    template <class Derived, class Variant>
     template <class T, class U>
-    void Z80::sbc(T& dst, U src)
+    void Z80Core<Derived, Variant>::sbc(T& dst, U src)
     {
         arithmetic_sub(dst, src+get_flag(0));
     }
 
+    template <class Derived, class Variant>
     template<class T>
-    unsigned int Z80::onescomp(T bin)
+    unsigned int Z80Core<Derived, Variant>::onescomp(T bin)
     {
         for(unsigned int i = 0; i<sizeof(bin)*8; ++i)
         {
@@ -116,9 +2738,13 @@ namespace Z80
         return bin;
     }
 
+    template <class Derived, class Variant>
     template<class T>
-    unsigned int Z80::twoscomp(T bin)
+    unsigned int Z80Core<Derived, Variant>::twoscomp(T bin)
     {
         return onescomp(bin)+1;
     }
-}
\ No newline at end of file
+}
+
+#undef IN
+#undef OUT